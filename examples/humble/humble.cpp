@@ -1,14 +1,20 @@
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <memory>
 
 #include "GL/glut.h"
 
+#include "nutshell_dynamics/fixedRigidBody.hpp"
 #include "nutshell_dynamics/rigidBody.hpp"
+#include "nutshell_dynamics/stepper.hpp"
 
 using std::sqrt;
 
 void displayFunc();
 void reshapeFunc(int, int);
 void timerFunc(int);
+void createWorld();
 
 unsigned short nut::refineIterations = 24u; // each iteration adds precision
 
@@ -25,6 +31,8 @@ int main(int argc, char* argv[])
 	glEnable(GL_CULL_FACE);
 	glShadeModel(GL_FLAT);
 
+	createWorld();
+
 	glutTimerFunc(1000, &timerFunc, 0);
 	glutMainLoop();
 }
@@ -49,14 +57,14 @@ namespace
 	const nut::RigidBody::Pool rigidBodyPool{vertices, surfaceNormals, 4}; // here vertices
 }
 
-class Tetrahedron : public nut::RigidBody // regular, solid and of uniform density
+class Tetrahedron : public nut::FixedRigidBody<4, 4> // regular, solid, uniform density
 {
 	public:
 
 		Tetrahedron(float mass, float edgeLength, const float(& position)[3],
 			const nut::ThreeVector<float>& velocity, float angularFrequency,
 			const nut::ThreeVector<float>& rotationAxis) :
-			nut::RigidBody{mass,
+			nut::FixedRigidBody<4, 4>{mass,
 			{.05f * mass * edgeLength * edgeLength,
 			 .05f * mass * edgeLength * edgeLength,
 			 .05f * mass * edgeLength * edgeLength},
@@ -66,12 +74,14 @@ class Tetrahedron : public nut::RigidBody // regular, solid and of uniform densi
 			  position[0], position[1], position[2], 1.f}},
 			velocity, angularFrequency, rotationAxis, bodyPool, rigidBodyPool} {}
 
-		void display()
+		// objectMatrix is taken from a snapshot rather than from the body, which the
+		// simulation thread may be moving.
+		void display(const float* objectMatrix)
 		{
 			float modelViewMatrix[16];
 			glGetFloatv(GL_MODELVIEW_MATRIX, modelViewMatrix);
 
-			glMultMatrixf(this->modelViewMatrix);
+			glMultMatrixf(objectMatrix);
 
 			glBegin(GL_TRIANGLE_STRIP);
 				glNormal3fv(this->getSurfaceNormal()[0]);
@@ -90,35 +100,63 @@ class Tetrahedron : public nut::RigidBody // regular, solid and of uniform densi
 		}
 };
 
-void displayFunc()
+namespace
 {
-	static Tetrahedron tets[] = {
-		{1.f, 6.f, {.01f,  .5f,  .0f}, {.0f, .0f, .0f}, .0f, {.0f, .0f, .0f}},
-		{1.f, 6.f, { .0f, -2.f,  .0f}, {.0f, .0f, .0f}, .0f, {.0f, .0f, .0f}},
-		{1.f, 6.f, { 1.f, .01f, .01f}, {.0f, .0f, .0f}, .0f, {.0f, .0f, .0f}},
-		{1.f, 6.f, {-1.f,  .1f,  .0f}, {.0f, .0f, .0f}, .0f, {.0f, .0f, .0f}},
-		{9.f, 6.f, {-5.f,  .0f,  .0f}, {.0f, .0f, .0f}, .0f, {.0f, .0f, .0f}},
-		{1.f, 6.f, { 1.f,  2.f,  .0f}, {.0f, .0f, .0f}, .0f, {.0f, .0f, .0f}},
-		{1.f, 6.f, { 2.f, -2.f,  .0f}, {.0f, .0f, .0f}, .0f, {.0f, .0f, .0f}},
-		{1.f, 6.f, {-.5f,  2.f,  .0f}, {.0f, .0f, .0f}, .0f, {.0f, .0f, .0f}},
+	// The bodies and the stepper that moves them.  Members are destroyed in reverse, so the
+	// stepper stops before the bodies go.
+	struct World
+	{
+		static const int numTets = 8;
+
+		Tetrahedron tets[numTets] = {
+			{1.f, 6.f, {.01f,  .5f,  .0f}, {.0f, .0f, .0f}, .0f, {.0f, .0f, .0f}},
+			{1.f, 6.f, { .0f, -2.f,  .0f}, {.0f, .0f, .0f}, .0f, {.0f, .0f, .0f}},
+			{1.f, 6.f, { 1.f, .01f, .01f}, {.0f, .0f, .0f}, .0f, {.0f, .0f, .0f}},
+			{1.f, 6.f, {-1.f,  .1f,  .0f}, {.0f, .0f, .0f}, .0f, {.0f, .0f, .0f}},
+			{9.f, 6.f, {-5.f,  .0f,  .0f}, {.0f, .0f, .0f}, .0f, {.0f, .0f, .0f}},
+			{1.f, 6.f, { 1.f,  2.f,  .0f}, {.0f, .0f, .0f}, .0f, {.0f, .0f, .0f}},
+			{1.f, 6.f, { 2.f, -2.f,  .0f}, {.0f, .0f, .0f}, .0f, {.0f, .0f, .0f}},
+			{1.f, 6.f, {-.5f,  2.f,  .0f}, {.0f, .0f, .0f}, .0f, {.0f, .0f, .0f}},
+		};
+
+		// runs the simulation beside the rendering
+		nut::Stepper stepper{std::chrono::milliseconds{16},
+			[this] { this->pullTogether(); }};
+
+		void pullTogether() // called by the stepper before each step
+		{
+			for (int i = 0; i < numTets; ++i) {
+				nut::ThreeVector<float> displacement =
+					nut::ThreeVector<float>{&(this->tets[i].getObjectMatrix()[12])};
+				this->tets[i].getVelocity() += -.001f * displacement.getUnitVector();
+			}
+		}
 	};
 
-	int numTets = sizeof(tets) / sizeof(*tets);
+	std::unique_ptr<World> world;
+}
+
+void createWorld()
+{
+	world.reset(new World);
 
-	for (int i = 0; i < numTets; ++i) {
-		nut::ThreeVector<float> displacement =
-			nut::ThreeVector<float>{&(tets[i].getObjectMatrix()[12])};
-		tets[i].getVelocity() += -.001f * displacement.getUnitVector();
-	}
+	// glutMainLoop doesn't return, and exit doesn't destroy locals.  The stepper has to
+	// stop before the bodies and the library's own statics go.
+	std::atexit([] { world.reset(); });
+}
 
-	nut::advanceState(); // all the work is done here
+void displayFunc()
+{
+	// all the work is done on the stepper's thread
+	const nut::Snapshot& snapshot = world->stepper.getLatestSnapshot();
 
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glMatrixMode(GL_MODELVIEW);
 	glLoadIdentity();
 	glTranslatef(.0f, .0f, -7.f); // camera transformation
-	for (int i = 0; i < numTets; ++i) {
-		tets[i].display();
+	// the bodies are in the order of creation
+	for (int i = 0; i < World::numTets; ++i) {
+		world->tets[i].display(snapshot.objectMatrices[i]);
 	}
 	glutSwapBuffers();
 }
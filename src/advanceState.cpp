@@ -14,14 +14,708 @@
    Dynamics.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "contact.hpp"
+#include "deformableBody.hpp"
+#include "heightfield.hpp"
 #include "rigidBody.hpp"
-//#include "staticBody.hpp"
+#include "staticBody.hpp"
+#include "transformArray.hpp"
 
 namespace nut
 {
+	float fixedTimeStep = 1.f;
+	unsigned short maxSteps = 4u;
+	unsigned short maxSubsteps = 8u;
+	float maxTravel = .5f;
+	bool eventDriven = false;
+	unsigned short maxImpacts = 8u;
+	float refineTolerance = .001f;
+	unsigned refineBudget = 0u;
+	unsigned short minRefineIterations = 8u;
+	std::vector<ThreeVector<float>> collisionFoci;
+	float lodDistanceRatio = .01f;
+	float lodTravelRatio = .1f;
+	RingBuffer<ContactEvent> contactEvents{4096u};
+
+	std::vector<ContactEvent> RigidBody::contacts;
+	std::vector<ContactEvent> RigidBody::lastContacts;
+
+	unsigned RigidBody::refineBudgetLeft = 0u;
+
+	namespace
+	{
+		// not yet simulated by advanceState(float)
+		float accumulatedTime = .0f;
+
+		// A contact naming the body and what it hit.  Pairs of rigid bodies are put in the
+		// same order every step.
+		ContactEvent getContact(const RigidBody& body, const RigidBody& otherBody)
+		{
+			ContactEvent contact{};
+			contact.bodies[0] = std::min(&body, &otherBody, std::less<const RigidBody*>{});
+			contact.bodies[1] = std::max(&body, &otherBody, std::less<const RigidBody*>{});
+			return contact;
+		}
+
+		ContactEvent getContact(const RigidBody& body, const StaticBody& staticBody)
+		{
+			ContactEvent contact{};
+			contact.bodies[0] = &body;
+			contact.staticBody = &staticBody;
+			return contact;
+		}
+
+		ContactEvent getContact(const RigidBody& body, const Heightfield& heightfield)
+		{
+			ContactEvent contact{};
+			contact.bodies[0] = &body;
+			contact.heightfield = &heightfield;
+			return contact;
+		}
+
+		// Whether the contacts are of the same bodies; orders them by those.
+		bool isBefore(const ContactEvent& first, const ContactEvent& second)
+		{
+			std::less<const void*> less;
+			const void* keys[2][4] = {
+				{first.bodies[0], first.bodies[1], first.staticBody, first.heightfield},
+				{second.bodies[0], second.bodies[1], second.staticBody, second.heightfield}};
+
+			return std::lexicographical_compare(keys[0], keys[0] + 4, keys[1], keys[1] + 4,
+				less);
+		}
+	}
+
+	template <typename Obstacle>
+	void RigidBody::detectCollisions(RigidBody& body,
+		const std::vector<Obstacle*>& obstacles,
+		std::vector<CollisionContext>& collisionContexts, float timeInterval)
+	{
+		for (auto i : obstacles)
+		{
+			if (!body.mayCollide(*i))
+				continue;
+
+			if (auto partialCollisionContext = body.doesCollide(*i))
+			{
+				collisionContexts.push_back(
+					std::make_tuple(1.f, &body, nullptr, partialCollisionContext));
+
+				refine(collisionContexts.back(), *i, timeInterval);
+				RigidBody::recordContact(getContact(body, *i),
+					*std::get<3>(collisionContexts.back()));
+			}
+		}
+	}
+
+	struct RigidBody::Impact
+	{
+		float time; // fraction of the substep
+		RigidBody* bodies[2]; // The second one is nullptr if the first hit an obstacle.
+		unsigned generations[2]; // of the bodies when this was predicted
+		std::array<ThreeVector<float>, 2>* partialCollisionContext;
+		ContactEvent contact; // to record if the impact is resolved
+
+		// for a heap with the earliest impact on top
+		bool operator>(const Impact& other) const { return this->time > other.time; }
+	};
+
+	template <typename Obstacle>
+	void RigidBody::predictImpact(RigidBody& body, const Obstacle& obstacle,
+		RigidBody* otherBody, float begin, float timeInterval, std::vector<Impact>& impacts)
+	{
+		if (body.impactCount >= maxImpacts ||
+			(otherBody && otherBody->impactCount >= maxImpacts) || !body.mayCollide(obstacle))
+		{
+			return;
+		}
+
+		auto partialCollisionContext = body.doesCollide(obstacle);
+		if (!partialCollisionContext)
+			return;
+
+		const ModelViewMatrix<float> modelViewMatrix[2] = {body.getObjectMatrix(),
+			otherBody ? otherBody->getObjectMatrix() : body.getObjectMatrix()};
+
+		float time = 1.f;
+		auto moveTo = [&](float newTime) {
+			body.move((newTime - time) * timeInterval);
+			if (otherBody)
+				otherBody->move((newTime - time) * timeInterval);
+			time = newTime;
+		};
+
+		// Bisect the range.  Its beginning is before and its end after the impact.
+		float range[2] = {begin, 1.f};
+
+		moveTo(begin);
+		auto overlap = body.doesCollide(obstacle);
+
+		unsigned short iterations = overlap ? 0u :
+			RigidBody::getRefineIterations(body, otherBody, (1.f - begin) * timeInterval);
+
+		for (unsigned short i = 0u; !overlap && i != iterations; ++i)
+		{
+			moveTo((range[0] + range[1]) / 2.f);
+
+			if (auto newContext = body.doesCollide(obstacle))
+			{
+				delete partialCollisionContext;
+				partialCollisionContext = newContext;
+				range[1] = time;
+			}
+			else
+			{
+				range[0] = time;
+			}
+		}
+
+		body.getObjectMatrix() = modelViewMatrix[0];
+		body.transform();
+		if (otherBody)
+		{
+			otherBody->getObjectMatrix() = modelViewMatrix[1];
+			otherBody->transform();
+		}
+
+		// Touching since begin: that contact has been resolved already or is resting.
+		if (overlap)
+		{
+			delete overlap;
+			delete partialCollisionContext;
+			return;
+		}
+
+		impacts.push_back(Impact{range[0], {&body, otherBody},
+			{body.generation, otherBody ? otherBody->generation : 0u},
+			partialCollisionContext, getContact(body, obstacle)});
+		std::push_heap(impacts.begin(), impacts.end(), std::greater<Impact>{});
+	}
+
+	void RigidBody::advanceEvents(float timeInterval)
+	{
+		for (auto i : RigidBody::rigidBodies)
+		{
+			i->move(timeInterval);
+			i->impactCount = 0u;
+		}
+
+		std::vector<Impact> impacts;
+
+		auto predictObstacleImpacts = [&](RigidBody& body, float begin) {
+			for (auto i : StaticBody::staticBodies)
+				RigidBody::predictImpact(body, *i, nullptr, begin, timeInterval, impacts);
+			for (auto i : Heightfield::heightfields)
+				RigidBody::predictImpact(body, *i, nullptr, begin, timeInterval, impacts);
+		};
+
+		for (auto i = RigidBody::rigidBodies.begin(); i != RigidBody::rigidBodies.end(); ++i)
+		{
+			for (auto j = i + 1; j != RigidBody::rigidBodies.end(); ++j)
+				RigidBody::predictImpact(**i, **j, *j, .0f, timeInterval, impacts);
+
+			predictObstacleImpacts(**i, .0f);
+		}
+
+		while (!impacts.empty())
+		{
+			std::pop_heap(impacts.begin(), impacts.end(), std::greater<Impact>{});
+			Impact impact = impacts.back();
+			impacts.pop_back();
+
+			RigidBody& body = *impact.bodies[0];
+			RigidBody* otherBody = impact.bodies[1];
+			auto& partialCollisionContext = *impact.partialCollisionContext;
+
+			if (body.generation == impact.generations[0] &&
+				(!otherBody || otherBody->generation == impact.generations[1]))
+			{
+				// Go back to the time of the impact and on to the end of the substep on the
+				// new course.
+				float remainder = (1.f - impact.time) * timeInterval;
+
+				body.move(-remainder);
+				if (otherBody)
+				{
+					otherBody->move(-remainder);
+					body.effectElasticCollision(*otherBody, partialCollisionContext[0],
+						partialCollisionContext[1]);
+					otherBody->move(remainder);
+					++otherBody->generation;
+					++otherBody->impactCount;
+				}
+				else
+				{
+					body.effectElasticCollision(partialCollisionContext[0],
+						partialCollisionContext[1]);
+				}
+				body.move(remainder);
+				++body.generation;
+				++body.impactCount;
+
+				RigidBody::recordContact(impact.contact, partialCollisionContext);
+
+				// Only the courses of these bodies have changed.
+				for (auto changedBody : impact.bodies)
+				{
+					if (!changedBody)
+						continue;
+
+					for (auto i : RigidBody::rigidBodies)
+					{
+						if (i != &body && i != otherBody)
+						{
+							RigidBody::predictImpact(*changedBody, *i, i, impact.time,
+								timeInterval, impacts);
+						}
+					}
+
+					predictObstacleImpacts(*changedBody, impact.time);
+				}
+
+				if (otherBody)
+				{
+					RigidBody::predictImpact(body, *otherBody, otherBody, impact.time,
+						timeInterval, impacts);
+				}
+			}
+
+			delete impact.partialCollisionContext;
+		}
+	}
+
+	unsigned short RigidBody::getSubstepCount(float timeInterval)
+	{
+		float substepCount = 1.f;
+
+		for (auto i : RigidBody::rigidBodies)
+		{
+			if (i->boundingRadius == .0f)
+				continue;
+
+			// how far a point of the body's surface may get at most
+			float travel = (i->velocity.getNorm() + i->angularFrequency * i->boundingRadius) *
+				timeInterval;
+
+			substepCount = std::max(substepCount,
+				std::ceil(travel / (maxTravel * i->boundingRadius)));
+		}
+
+		// at least one even if maxSubsteps is 0
+		return static_cast<unsigned short>(
+			std::max(std::min(substepCount, static_cast<float>(maxSubsteps)), 1.f));
+	}
+
+	unsigned short RigidBody::getRefineIterations(const RigidBody& body,
+		const RigidBody* otherBody, float timeInterval)
+	{
+		ThreeVector<float> velocity(body.velocity);
+		float spin = body.angularFrequency * body.boundingRadius;
+		float radius = body.boundingRadius;
+
+		if (otherBody)
+		{
+			velocity -= otherBody->velocity;
+			spin += otherBody->angularFrequency * otherBody->boundingRadius;
+			radius = std::min(radius, otherBody->boundingRadius);
+		}
+
+		// how far points of the bodies may travel relative to each other
+		float travel = (velocity.getNorm() + spin) * timeInterval;
+		float tolerance = refineTolerance * radius;
+
+		unsigned short iterations = refineIterations;
+
+		if (travel <= tolerance)
+			iterations = 1u;
+		else if (tolerance > .0f)
+		{
+			iterations = static_cast<unsigned short>(std::min(
+				std::ceil(std::log2(travel / tolerance)), static_cast<float>(refineIterations)));
+		}
+
+		unsigned& budgetLeft = RigidBody::refineBudgetLeft;
+
+		if (budgetLeft < iterations)
+		{
+			iterations = std::min(iterations, static_cast<unsigned short>(
+				std::max<unsigned>(budgetLeft, minRefineIterations)));
+		}
+		budgetLeft -= std::min<unsigned>(iterations, budgetLeft);
+
+		return iterations;
+	}
+
+	void RigidBody::selectCollisionLevel(float timeInterval)
+	{
+		float deviation = lodTravelRatio * timeInterval *
+			(this->velocity.getNorm() + this->angularFrequency * this->boundingRadius);
+
+		if (lodDistanceRatio > .0f && !collisionFoci.empty())
+		{
+			const ThreeVector<float> position{&this->getObjectMatrix()[12]};
+			float distance2 = std::numeric_limits<float>::infinity();
+
+			for (const auto& focus : collisionFoci)
+			{
+				ThreeVector<float> offset(position - focus);
+				distance2 = std::min(distance2, offset * offset);
+			}
+
+			deviation = std::max(deviation, lodDistanceRatio *
+				(std::sqrt(distance2) - this->boundingRadius));
+		}
+
+		const std::vector<CollisionLevel>& levels = *this->collisionLevels;
+		unsigned level = 0u;
+
+		for (unsigned i = 1u; i != levels.size(); ++i)
+		{
+			if (levels[i].deviation <= deviation)
+				level = i;
+		}
+
+		if (level == this->collisionLevel)
+			return;
+
+		this->useCollisionLevel(level);
+		this->transform();
+	}
+
+	void RigidBody::useCollisionLevel(unsigned level)
+	{
+		assert(this->collisionLevels && !this->kernels);
+
+		const CollisionLevel& collisionLevel = (*this->collisionLevels)[level];
+
+		this->collisionLevel = level;
+		this->Body::pool = collisionLevel.bodyPool;
+		this->pool = collisionLevel.rigidBodyPool;
+	}
+
+	void RigidBody::advanceState(float timeInterval)
+	{
+		Progress progress{timeInterval};
+		RigidBody::advance(progress, std::chrono::steady_clock::time_point::max());
+	}
+
+	bool RigidBody::advance(Progress& progress,
+		std::chrono::steady_clock::time_point deadline)
+	{
+		using Stage = Progress::Stage;
+
+		const auto& bodies = RigidBody::rigidBodies;
+		auto& collisionContexts = progress.collisionContexts;
+
+		while (progress.stage != Stage::DONE)
+		{
+			float timeInterval = progress.timeInterval / std::max<unsigned short>(
+				progress.substepCount, 1u); // of a substep
+
+			switch (progress.stage)
+			{
+				case Stage::BEGIN:
+					RigidBody::refineBudgetLeft = refineBudget ? refineBudget :
+						std::numeric_limits<unsigned>::max();
+
+					for (auto i : bodies)
+					{
+						i->previousModelViewMatrix = i->getObjectMatrix();
+
+						if (i->collisionLevels)
+							i->selectCollisionLevel(progress.timeInterval);
+					}
+
+					progress.substepCount = RigidBody::getSubstepCount(progress.timeInterval);
+					progress.stage = Stage::MOVE;
+					break;
+
+				case Stage::MOVE:
+					if (eventDriven)
+					{
+						RigidBody::advanceEvents(timeInterval);
+						progress.stage = Stage::DEFORM;
+						break;
+					}
+
+					for (auto i : bodies) i->move(timeInterval);
+
+					progress.reaches.clear();
+					for (auto i : bodies) progress.reaches.emplace_back(*i);
+
+					// a posteriori collision check
+					progress.i = 0u;
+					progress.j = 1u;
+					progress.stage = Stage::PAIRS;
+					break;
+
+				case Stage::PAIRS:
+				{
+					auto& reaches = progress.reaches;
+					std::size_t i = progress.i;
+					std::size_t j = progress.j;
+
+					if (i >= reaches.size())
+					{
+						progress.i = 0u;
+						progress.stage = Stage::OBSTACLES;
+						break;
+					}
+
+					for (; j < reaches.size(); ++j)
+					{
+						if (!reaches[i].mayCollide(reaches[j]))
+							continue;
+
+						RigidBody* body = bodies[i];
+						RigidBody* otherBody = bodies[j];
+
+						if (auto partialCollisionContext = body->doesCollide(*otherBody))
+						{
+							collisionContexts.push_back(
+								std::make_tuple(1.f, body, otherBody, partialCollisionContext));
+
+							refine(collisionContexts.back(), *otherBody, timeInterval);
+							RigidBody::recordContact(getContact(*body, *otherBody),
+								*std::get<3>(collisionContexts.back()));
+
+							// refine leaves both bodies at the time of the collision.
+							reaches[i] = Reach{*body};
+							reaches[j] = Reach{*otherBody};
+
+							++j;
+							break;
+						}
+					}
+
+					if (j < reaches.size())
+						progress.j = j;
+					else
+					{
+						progress.i = i + 1u;
+						progress.j = i + 2u;
+					}
+					break;
+				}
+
+				case Stage::OBSTACLES:
+					// Static bodies and heightfields don't move, so they can't hit each other.
+					// All bodies are tested against the former, then against the latter.
+					if (progress.i < bodies.size())
+					{
+						RigidBody::detectCollisions(*bodies[progress.i++],
+							StaticBody::staticBodies, collisionContexts, timeInterval);
+						break;
+					}
+					else if (progress.i < 2u * bodies.size())
+					{
+						RigidBody::detectCollisions(*bodies[progress.i++ - bodies.size()],
+							Heightfield::heightfields, collisionContexts, timeInterval);
+						break;
+					}
+
+					std::sort(collisionContexts.begin(), collisionContexts.end(),
+						[](const CollisionContext& a, const CollisionContext& b) {
+							return std::get<0>(a) < std::get<0>(b);
+						}
+					);
+
+					progress.i = 0u;
+					progress.stage = Stage::RESPONSE;
+					break;
+
+				case Stage::RESPONSE:
+					if (progress.i < collisionContexts.size())
+					{
+						const auto& i = collisionContexts[progress.i++];
+
+						if (std::get<2>(i))
+						{
+							std::get<1>(i)->effectElasticCollision(*std::get<2>(i),
+								(*std::get<3>(i))[0], (*std::get<3>(i))[1]);
+
+							std::get<1>(i)->move(std::get<0>(i) * timeInterval);
+							std::get<2>(i)->move(std::get<0>(i) * timeInterval);
+						}
+						else
+						{
+							std::get<1>(i)->effectElasticCollision((*std::get<3>(i))[0],
+									(*std::get<3>(i))[1]);
+
+							std::get<1>(i)->move(std::get<0>(i) * timeInterval);
+						}
+
+						// TODO: check for follow-up collisions.
+
+						delete std::get<3>(i);
+						break;
+					}
+
+					collisionContexts.clear();
+					progress.stage = Stage::DEFORM;
+					break;
+
+				case Stage::DEFORM:
+					DeformableBody::advanceState(timeInterval);
+
+					progress.stage = ++progress.substep != progress.substepCount ? Stage::MOVE :
+						Stage::END;
+					break;
+
+				case Stage::END:
+					TransformArray::resetDirtyBits();
+
+					for (auto i : bodies)
+					{
+						const float* matrix = i->getObjectMatrix();
+						if (!std::equal(matrix, matrix + 16, static_cast<const float*>(
+							i->previousModelViewMatrix)))
+						{
+							TransformArray::markDirty(i->transformIndex);
+						}
+					}
+
+					RigidBody::reportContacts();
+					progress.stage = Stage::DONE;
+					break;
+
+				case Stage::DONE:
+					break;
+			}
+
+			if (deadline != std::chrono::steady_clock::time_point::max() &&
+				std::chrono::steady_clock::now() >= deadline)
+			{
+				break;
+			}
+		}
+
+		return progress.stage == Stage::DONE;
+	}
+
+	RigidBody::Progress::~Progress()
+	{
+		// The contacts of an abandoned step would be reported with the next one.
+		if (this->stage != Stage::DONE)
+			RigidBody::contacts.clear();
+
+		std::size_t begin = this->stage == Stage::RESPONSE ? this->i : 0u;
+
+		for (std::size_t i = begin; i < this->collisionContexts.size(); ++i)
+			delete std::get<3>(this->collisionContexts[i]);
+	}
+
+	void RigidBody::recordContact(ContactEvent contact,
+		const std::array<ThreeVector<float>, 2>& partialCollisionContext)
+	{
+		contact.point = partialCollisionContext[0];
+		contact.normal = partialCollisionContext[1];
+		RigidBody::contacts.push_back(contact);
+	}
+
+	void RigidBody::reportContacts()
+	{
+		auto& contacts = RigidBody::contacts;
+		auto& lastContacts = RigidBody::lastContacts;
+
+		// Keep the first contact of each pair.
+		std::stable_sort(contacts.begin(), contacts.end(), isBefore);
+		contacts.erase(std::unique(contacts.begin(), contacts.end(),
+			[](const ContactEvent& first, const ContactEvent& second) {
+				return !isBefore(first, second) && !isBefore(second, first);
+			}), contacts.end());
+
+		// Both are sorted; walk them side by side.
+		auto last = lastContacts.begin();
+
+		for (auto& i : contacts)
+		{
+			for (; last != lastContacts.end() && isBefore(*last, i); ++last)
+			{
+				last->type = ContactType::END;
+				contactEvents.push(*last);
+			}
+
+			if (last != lastContacts.end() && !isBefore(i, *last))
+			{
+				i.type = ContactType::PERSIST;
+				++last;
+			}
+			else
+			{
+				i.type = ContactType::BEGIN;
+			}
+
+			contactEvents.push(i);
+		}
+
+		for (; last != lastContacts.end(); ++last)
+		{
+			last->type = ContactType::END;
+			contactEvents.push(*last);
+		}
+
+		lastContacts.swap(contacts);
+		contacts.clear();
+	}
+
+	void RigidBody::forgetContacts(const void* body)
+	{
+		auto isOf = [body](const ContactEvent& contact) {
+			return contact.bodies[0] == body || contact.bodies[1] == body ||
+				contact.staticBody == body || contact.heightfield == body;
+		};
+
+		for (auto contacts : {&RigidBody::contacts, &RigidBody::lastContacts})
+		{
+			contacts->erase(std::remove_if(contacts->begin(), contacts->end(), isOf),
+				contacts->end());
+		}
+	}
+
+	void RigidBody::setLastContacts(const std::vector<ContactEvent>& contacts)
+	{
+		RigidBody::lastContacts = contacts;
+		RigidBody::contacts.clear();
+	}
+
 	void advanceState()
 	{
-		RigidBody::advanceState();
+		RigidBody::advanceState(1.f);
+	}
+
+	void advanceState(float elapsedTime)
+	{
+		accumulatedTime = std::min(accumulatedTime + elapsedTime, maxSteps * fixedTimeStep);
+
+		while (accumulatedTime >= fixedTimeStep)
+		{
+			RigidBody::advanceState(fixedTimeStep);
+			accumulatedTime -= fixedTimeStep;
+		}
+	}
+
+	float getInterpolationAlpha()
+	{
+		return accumulatedTime / fixedTimeStep;
+	}
+
+	float getCarriedTime()
+	{
+		return accumulatedTime;
+	}
+
+	void setCarriedTime(float carriedTime)
+	{
+		accumulatedTime = carriedTime;
 	}
 }
 
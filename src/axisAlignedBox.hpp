@@ -0,0 +1,90 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AXISALIGNEDBOX_HPP_SEEN
+#define AXISALIGNEDBOX_HPP_SEEN
+
+#include <algorithm>
+#include <limits>
+
+namespace nut
+{
+	// Box with edges parallel to the axes of global coordinates.
+	struct AxisAlignedBox
+	{
+		float min[3];
+		float max[3];
+	};
+
+	// Returns a box that contains nothing; growing it by anything yields that thing's box.
+	inline AxisAlignedBox getEmptyBox()
+	{
+		const float infinity = std::numeric_limits<float>::infinity();
+		return {{infinity, infinity, infinity}, {-infinity, -infinity, -infinity}};
+	}
+
+	inline void grow(AxisAlignedBox& box, const float point[3])
+	{
+		for (int i = 0; i != 3; ++i)
+		{
+			box.min[i] = std::min(box.min[i], point[i]);
+			box.max[i] = std::max(box.max[i], point[i]);
+		}
+	}
+
+	inline void grow(AxisAlignedBox& box, const AxisAlignedBox& other)
+	{
+		for (int i = 0; i != 3; ++i)
+		{
+			box.min[i] = std::min(box.min[i], other.min[i]);
+			box.max[i] = std::max(box.max[i], other.max[i]);
+		}
+	}
+
+	// Touching boxes overlap.
+	inline bool doOverlap(const AxisAlignedBox& first, const AxisAlignedBox& second)
+	{
+		return first.min[0] <= second.max[0] && second.min[0] <= first.max[0] &&
+			first.min[1] <= second.max[1] && second.min[1] <= first.max[1] &&
+			first.min[2] <= second.max[2] && second.min[2] <= first.max[2];
+	}
+
+	// Narrow range, distances along the ray from origin whose direction has the given
+	// componentwise inverse, to the part of the ray inside the box.  Returns whether any of
+	// it is left.  Empty boxes are missed.  See Ericson, Real-Time Collision Detection,
+	// section 5.3.3.
+	inline bool clipRay(const AxisAlignedBox& box, const float origin[3],
+		const float inverseDirection[3], float (& range)[2])
+	{
+		for (int i = 0; i != 3; ++i)
+		{
+			if (box.min[i] > box.max[i])
+				return false;
+
+			float entry = (box.min[i] - origin[i]) * inverseDirection[i];
+			float exit = (box.max[i] - origin[i]) * inverseDirection[i];
+
+			range[0] = std::max(range[0], std::min(entry, exit));
+			range[1] = std::min(range[1], std::max(entry, exit));
+		}
+
+		return range[0] <= range[1];
+	}
+}
+
+#endif //AXISALIGNEDBOX_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -19,13 +19,15 @@
 #include <cmath>
 #include <cstddef> // std::size_t
 
+#include "axisAlignedBox.hpp"
 #include "body.hpp"
+#include "triangleTree.hpp"
 
 namespace nut
 {
 	Body::Body(ThreeVector<float> vertices[], ThreeVector<float> surfaceNormals[],
 		const Body::Pool& pool) :
-		vertices{vertices}, surfaceNormals{surfaceNormals}, pool(pool) {}
+		vertices{vertices}, surfaceNormals{surfaceNormals}, pool{&pool} {}
 
 	inline std::array<ThreeVector<float>, 2>*
 	Body::doesCollide(const Body(& body)[2], const unsigned(& faceIndex)[2])
@@ -51,6 +53,13 @@ namespace nut
 			&this->surfaceNormals[faceIdentifier], &otherBody.surfaceNormals[otherIdentifier]
 		};
 
+		return Body::doesCollide(faces, surfaceNormals);
+	}
+
+	std::array<ThreeVector<float>, 2>*
+	Body::doesCollide(const ThreeVector<float>* const (& faces)[2][3],
+		const ThreeVector<float>* const (& surfaceNormals)[2])
+	{
 		float distance[2][3];
 
 		// Compute the minimal distance from all of the first face's vertices to the second
@@ -249,6 +258,45 @@ namespace nut
 		}
 		return nullptr;
 	}
+
+	std::array<ThreeVector<float>, 2>*
+	Body::doesCollide(const Body& otherBody, const TriangleTree& otherTree) const
+	{
+		std::array<ThreeVector<float>, 2>* partialCollisionContext = nullptr;
+
+		for (unsigned i = 0; i != this->getTriangleCount(); ++i)
+		{
+			AxisAlignedBox box = getEmptyBox();
+			grow(box, this->vertices[this->getFaces()[i][0]]);
+			grow(box, this->vertices[this->getFaces()[i][1]]);
+			grow(box, this->vertices[this->getFaces()[i][2]]);
+
+			// We take the first hit.
+			if (otherTree.visitOverlaps(box, [&](unsigned j) {
+					return (partialCollisionContext = this->doesCollide(otherBody, i, j));
+				}))
+			{
+				return partialCollisionContext;
+			}
+		}
+		return nullptr;
+	}
+
+	void computeSurfaceNormals(const Body::Pool& pool, const ThreeVector<float> vertices[],
+		ThreeVector<float> surfaceNormals[])
+	{
+		for (std::size_t i = 0; i != std::get<1>(pool); ++i)
+		{
+			const unsigned (& face)[3] = std::get<0>(pool)[i];
+
+			surfaceNormals[i] = getCrossProduct(vertices[face[1]] - vertices[face[0]],
+				vertices[face[2]] - vertices[face[0]]);
+
+			// Leave degenerate triangles with a null vector rather than NaNs.
+			if (float norm = surfaceNormals[i].getNorm())
+				surfaceNormals[i] = surfaceNormals[i] / norm;
+		}
+	}
 }
 
 // vim: tw=90 ts=2 sts=-1 sw=0 noet
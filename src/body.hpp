@@ -25,6 +25,8 @@
 
 namespace nut
 {
+	class TriangleTree;
+
 	// Does not handle collision or transformations: solely implements functionality for
 	// collison detection.  TODO: make this a CRTP base class?
 	class Body
@@ -39,18 +41,13 @@ namespace nut
 
 		Body() = delete; // Redundant while a user-defined ctor exists, but let's be explicit.
 		Body(const Body&) = delete;
-		Body(Body&&) = default;
+		Body(Body&&) = delete; // GeometryArena keeps track of Body objects by address.
 		Body(ThreeVector<float> vertices[], ThreeVector<float> surfaceNormals[], const Pool&);
 
 		~Body() = default;
 
 		Body& operator=(const Body&) = delete;
-		Body& operator=(Body&&) = default;
-
-		// Set up the next iteration of the simulation by moving all active Body objects and
-		// resolving the resulting collisions using the collision response defined by the
-		// derived class.
-		static void advanceState(float timeInterval = 1.f);
+		Body& operator=(Body&&) = delete;
 
 		// Detect collisions and construct a sequence of the respective data used to resolve
 		// each collision.
@@ -60,28 +57,45 @@ namespace nut
 		// Otherwise return false.
 		static bool registerCollision(const Body&, const Body&);
 
-		const unsigned(* getFaces() const)[3] { return std::get<0>(this->pool); }
+		const unsigned(* getFaces() const)[3] { return std::get<0>(*this->pool); }
 
-		unsigned getTriangleCount() const { return std::get<1>(this->pool); }
+		unsigned getTriangleCount() const { return std::get<1>(*this->pool); }
 
 		// Returns nullptr if the bodies don't overlap.
 		std::array<ThreeVector<float>, 2>* doesCollide(const Body&) const;
 
-		// Data unique to single Body objects.  Use global cooridnates.  Derived classes need
-		// to initialize and continuously update this data.
-		ThreeVector<float>* const vertices;
-		ThreeVector<float>* const surfaceNormals;
+		// Same as above, but only tests the triangles of the other body that the tree puts
+		// near those of this one.  The tree has to be built over the other body's geometry.
+		std::array<ThreeVector<float>, 2>* doesCollide(const Body&, const TriangleTree&) const;
 
-		const Pool& pool; // Shared by a group of Body objects.
+		// Test two triangles given by pointers to their vertices and surface normals.
+		static std::array<ThreeVector<float>, 2>*
+		doesCollide(const ThreeVector<float>* const (& faces)[2][3],
+			const ThreeVector<float>* const (& surfaceNormals)[2]);
 
-		private:
+		// Data unique to single Body objects.  Use global cooridnates.  Derived classes need
+		// to initialize and continuously update this data.  Only GeometryArena changes the
+		// pointers themselves.
+		ThreeVector<float>* vertices;
+		ThreeVector<float>* surfaceNormals;
+
+		const Pool* pool; // Shared by a group of Body objects.
 
 		std::array<ThreeVector<float>, 2>*
 		doesCollide(const Body&, unsigned triangleIndex, unsigned otherIndex) const;
 
 		static std::array<ThreeVector<float>, 2>*
 		doesCollide(const Body(&)[2], const unsigned(& faceIndex)[2]);
+
+		private:
+
+		friend class GeometryArena;
 	};
+
+	// Fill surfaceNormals with the unit normal of each triangle of the pool.  Triangles are
+	// taken to be wound counterclockwise when seen from outside, as in OBJ and STL files.
+	void computeSurfaceNormals(const Body::Pool&, const ThreeVector<float> vertices[],
+		ThreeVector<float> surfaceNormals[]);
 }
 
 #endif //BODY_HPP_SEEN
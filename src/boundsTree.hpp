@@ -0,0 +1,241 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BOUNDSTREE_HPP_SEEN
+#define BOUNDSTREE_HPP_SEEN
+
+#include <algorithm>
+#include <cstddef> // std::size_t
+#include <numeric>
+#include <vector>
+
+#include "axisAlignedBox.hpp"
+
+namespace nut
+{
+	// Bounding volume hierarchy of axis-aligned boxes over a set of leaves, e.g. the
+	// triangles of a mesh or the boxes of bodies.  Built top-down by splitting at the
+	// median center along the widest axis.  LeafBounds tells the bounds of the leaves:
+	//
+	//   AxisAlignedBox getBox(unsigned leafIndex) const;
+	//   float getCenter(unsigned leafIndex, int axis) const; // any fixed multiple will do
+	template <typename LeafBounds>
+	class BoundsTree
+	{
+		public:
+
+		BoundsTree() = delete;
+		BoundsTree(std::size_t leafCount, const LeafBounds&);
+
+		~BoundsTree() = default;
+
+		// Call visit(leafIndex) for each leaf whose box overlaps the given one, until a call
+		// returns true.  Returns whether one did.
+		template <typename Visitor>
+		bool visitOverlaps(const AxisAlignedBox&, Visitor visit) const;
+
+		// Call visit(leafIndex) for each leaf whose box the ray from origin with the given
+		// inverse direction hits within length.  visit returns the length to cut the ray to,
+		// e.g. the distance of a hit, so farther boxes are skipped.
+		template <typename Visitor>
+		void visitRay(const float origin[3], const float inverseDirection[3], float length,
+			Visitor visit) const;
+
+		// Recompute all boxes for new leaf bounds, keeping the topology of the tree.
+		void refit(const LeafBounds&);
+
+		// Box of all leaves.
+		const AxisAlignedBox& getBounds() const { return this->nodes.front().box; }
+
+		private:
+
+		// Leaves hold at most this many leaf indices.
+		static const unsigned leafSize = 4u;
+
+		// Nodes are stored in depth-first order: the first child of an inner node directly
+		// follows it.
+		struct Node
+		{
+			AxisAlignedBox box;
+			unsigned index; // of the first leaf index of a leaf or the second child otherwise
+			unsigned leafCount; // 0 for inner nodes
+		};
+
+		void build(const LeafBounds&, unsigned begin, unsigned end);
+
+		std::vector<Node> nodes;
+		std::vector<unsigned> leaves; // indices, grouped by leaf node
+	};
+
+	template <typename LeafBounds>
+	BoundsTree<LeafBounds>::BoundsTree(std::size_t leafCount, const LeafBounds& bounds) :
+		leaves(leafCount)
+	{
+		std::iota(this->leaves.begin(), this->leaves.end(), 0u);
+
+		if (leafCount == 0u)
+			this->nodes.push_back(Node{getEmptyBox(), 0u, 0u}); // an empty "inner" node
+		else
+			this->build(bounds, 0u, static_cast<unsigned>(leafCount));
+	}
+
+	template <typename LeafBounds>
+	template <typename Visitor>
+	bool BoundsTree<LeafBounds>::visitOverlaps(const AxisAlignedBox& box, Visitor visit)
+		const
+	{
+		// The root of an empty tree is an inner node without children.
+		if (this->leaves.empty())
+			return false;
+
+		unsigned stack[64];
+		unsigned stackSize = 0u;
+
+		for (unsigned i = 0u;;)
+		{
+			const Node& node = this->nodes[i];
+
+			if (doOverlap(node.box, box))
+			{
+				if (node.leafCount == 0u)
+				{
+					stack[stackSize++] = node.index;
+					i = i + 1u;
+					continue;
+				}
+
+				for (unsigned j = node.index; j != node.index + node.leafCount; ++j)
+				{
+					if (visit(this->leaves[j]))
+						return true;
+				}
+			}
+
+			if (stackSize == 0u)
+				return false;
+
+			i = stack[--stackSize];
+		}
+	}
+
+	template <typename LeafBounds>
+	template <typename Visitor>
+	void BoundsTree<LeafBounds>::visitRay(const float origin[3],
+		const float inverseDirection[3], float length, Visitor visit) const
+	{
+		if (this->leaves.empty())
+			return;
+
+		unsigned stack[64];
+		unsigned stackSize = 0u;
+
+		for (unsigned i = 0u;;)
+		{
+			const Node& node = this->nodes[i];
+			float range[2] = {.0f, length};
+
+			if (clipRay(node.box, origin, inverseDirection, range))
+			{
+				if (node.leafCount == 0u)
+				{
+					stack[stackSize++] = node.index;
+					i = i + 1u;
+					continue;
+				}
+
+				for (unsigned j = node.index; j != node.index + node.leafCount; ++j)
+					length = visit(this->leaves[j]);
+			}
+
+			if (stackSize == 0u)
+				return;
+
+			i = stack[--stackSize];
+		}
+	}
+
+	template <typename LeafBounds>
+	void BoundsTree<LeafBounds>::refit(const LeafBounds& bounds)
+	{
+		if (this->leaves.empty())
+			return;
+
+		// Children follow their parents, so going backwards visits them first.
+		for (std::size_t i = this->nodes.size(); i-- != 0u;)
+		{
+			Node& node = this->nodes[i];
+
+			if (node.leafCount == 0u)
+			{
+				node.box = this->nodes[i + 1u].box;
+				grow(node.box, this->nodes[node.index].box);
+			}
+			else
+			{
+				node.box = getEmptyBox();
+				for (unsigned j = node.index; j != node.index + node.leafCount; ++j)
+					grow(node.box, bounds.getBox(this->leaves[j]));
+			}
+		}
+	}
+
+	template <typename LeafBounds>
+	void BoundsTree<LeafBounds>::build(const LeafBounds& bounds, unsigned begin,
+		unsigned end)
+	{
+		unsigned nodeIndex = static_cast<unsigned>(this->nodes.size());
+		this->nodes.push_back(Node{getEmptyBox(), begin, end - begin});
+
+		AxisAlignedBox box = getEmptyBox(), centerBox = getEmptyBox();
+
+		for (unsigned i = begin; i != end; ++i)
+		{
+			const unsigned leaf = this->leaves[i];
+			grow(box, bounds.getBox(leaf));
+
+			const float center[3] = {bounds.getCenter(leaf, 0), bounds.getCenter(leaf, 1),
+				bounds.getCenter(leaf, 2)};
+			grow(centerBox, center);
+		}
+
+		this->nodes[nodeIndex].box = box;
+
+		if (end - begin <= leafSize)
+			return;
+
+		int axis = 0;
+		for (int i = 1; i != 3; ++i)
+		{
+			if (centerBox.max[i] - centerBox.min[i] > centerBox.max[axis] - centerBox.min[axis])
+				axis = i;
+		}
+
+		unsigned middle = begin + (end - begin) / 2u;
+		std::nth_element(this->leaves.begin() + begin, this->leaves.begin() + middle,
+			this->leaves.begin() + end, [&](unsigned first, unsigned second) {
+				return bounds.getCenter(first, axis) < bounds.getCenter(second, axis);
+			});
+
+		this->nodes[nodeIndex].leafCount = 0u;
+		this->build(bounds, begin, middle);
+		this->nodes[nodeIndex].index = static_cast<unsigned>(this->nodes.size());
+		this->build(bounds, middle, end);
+	}
+}
+
+#endif //BOUNDSTREE_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
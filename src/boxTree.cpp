@@ -0,0 +1,32 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "boxTree.hpp"
+
+namespace nut
+{
+	float BoxBounds::getCenter(unsigned boxIndex, int axis) const
+	{
+		return this->boxes[boxIndex].min[axis] + this->boxes[boxIndex].max[axis];
+	}
+
+	BoxTree::BoxTree(const std::vector<AxisAlignedBox>& boxes) :
+		BoundsTree<BoxBounds>{boxes.size(), BoxBounds{boxes}}
+	{
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,49 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BOXTREE_HPP_SEEN
+#define BOXTREE_HPP_SEEN
+
+#include <vector>
+
+#include "boundsTree.hpp"
+
+namespace nut
+{
+	// Bounds of a set of boxes, e.g. those of bodies, for a BoundsTree over them.
+	struct BoxBounds
+	{
+		const std::vector<AxisAlignedBox>& boxes;
+
+		AxisAlignedBox getBox(unsigned boxIndex) const { return this->boxes[boxIndex]; }
+		float getCenter(unsigned boxIndex, int axis) const; // twice the center
+	};
+
+	// Bounding volume hierarchy over a set of boxes; visitors are given box indices.
+	class BoxTree : public BoundsTree<BoxBounds>
+	{
+		public:
+
+		BoxTree() = delete;
+		explicit BoxTree(const std::vector<AxisAlignedBox>& boxes);
+
+		~BoxTree() = default;
+	};
+}
+
+#endif //BOXTREE_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
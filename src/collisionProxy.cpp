@@ -0,0 +1,469 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef> // std::size_t
+#include <limits>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "axisAlignedBox.hpp"
+#include "collisionProxy.hpp"
+#include "shape.hpp"
+#include "triangleTree.hpp"
+
+namespace nut
+{
+	namespace
+	{
+		// The deviation of a proxy is refined until within this fraction of the diagonal of
+		// the box around the mesh, bisecting the triangles of the proxy at most this often.
+		constexpr float deviationTolerance = .01f;
+		constexpr unsigned maxBisections = 6u;
+
+		const unsigned none = std::numeric_limits<unsigned>::max();
+
+		// Diagonal of the box around the vertices of the pool.
+		float getDiagonal(const RigidBody::Pool& pool)
+		{
+			AxisAlignedBox box = getEmptyBox();
+			for (unsigned i = 0u; i != std::get<2>(pool); ++i)
+				grow(box, std::get<0>(pool)[i]);
+
+			if (std::get<2>(pool) == 0u)
+				return .0f;
+
+			return ThreeVector<float>(box.max[0] - box.min[0], box.max[1] - box.min[1],
+				box.max[2] - box.min[2]).getNorm();
+		}
+
+		// A triangle of a convex hull under construction, wound counterclockwise when seen
+		// from outside.
+		struct HullFace
+		{
+			unsigned corners[3];
+			ThreeVector<double> normal; // unit vector, or null for degenerate triangles
+			double offset; // of the plane of the triangle along normal
+		};
+
+		HullFace makeHullFace(const std::vector<ThreeVector<double>>& points, unsigned a,
+			unsigned b, unsigned c)
+		{
+			ThreeVector<double> normal = getCrossProduct(points[b] - points[a],
+				points[c] - points[a]);
+
+			if (double norm = normal.getNorm())
+				normal /= norm;
+
+			return HullFace{{a, b, c}, ThreeVector<double>(normal), normal * points[a]};
+		}
+
+		// Signed distance of the point from the plane of the face, positive in front of it.
+		double getHeight(const HullFace& face, const ThreeVector<double>& point)
+		{
+			return face.normal * point - face.offset;
+		}
+
+		// Finds upper bounds of the distance of points and triangles from the surface of a
+		// mesh.
+		class DistanceBound
+		{
+			public:
+
+			DistanceBound(const Body::Pool& bodyPool, const RigidBody::Pool& rigidBodyPool,
+				float tolerance) :
+				faces{std::get<0>(bodyPool)}, vertices{std::get<0>(rigidBodyPool)},
+				tree{this->faces, std::get<1>(bodyPool), this->vertices},
+				tolerance{tolerance}, isEmpty{std::get<1>(bodyPool) == 0u}
+			{}
+
+			// Distance of the point from the mesh.  hint is an upper bound of it, or
+			// infinity.
+			float getDistance(const ThreeVector<float>& point, float hint) const;
+
+			// Bound of the distance of any point of the triangle with the given corners,
+			// whose distances are known, from the mesh.
+			float getDistance(const ThreeVector<float>* const (& corners)[3],
+				const float (& distances)[3], unsigned bisections);
+
+			private:
+
+			const unsigned (* const faces)[3];
+			const ThreeVector<float>* const vertices;
+			const TriangleTree tree;
+			const float tolerance;
+			const bool isEmpty;
+
+			float lowerBound = .0f; // of the largest distance of a point of any triangle
+		};
+
+		float DistanceBound::getDistance(const ThreeVector<float>& point, float hint) const
+		{
+			if (this->isEmpty)
+				return std::numeric_limits<float>::infinity();
+
+			// Every triangle within radius of the point overlaps the box; grow it until one
+			// does and then to the closest one found.
+			for (float radius = std::min(hint, this->tolerance);;)
+			{
+				AxisAlignedBox box{
+					{point[0] - radius, point[1] - radius, point[2] - radius},
+					{point[0] + radius, point[1] + radius, point[2] + radius}};
+				float distance = std::numeric_limits<float>::infinity();
+
+				this->tree.visitOverlaps(box, [&](unsigned i) {
+					const unsigned (& face)[3] = this->faces[i];
+					const ThreeVector<float>* const corners[3] = {
+						&this->vertices[face[0]], &this->vertices[face[1]],
+						&this->vertices[face[2]]};
+
+					distance = std::min(distance,
+						(getClosestPoint(corners, point) - point).getNorm());
+					return false;
+				});
+
+				if (distance <= radius || radius >= hint)
+					return distance;
+
+				radius = std::min(hint, std::isinf(distance) ?
+					std::max(2.f * radius, std::numeric_limits<float>::min()) : distance);
+			}
+		}
+
+		float DistanceBound::getDistance(const ThreeVector<float>* const (& corners)[3],
+			const float (& distances)[3], unsigned bisections)
+		{
+			const ThreeVector<float>& a = *corners[0];
+			const ThreeVector<float>& b = *corners[1];
+			const ThreeVector<float>& c = *corners[2];
+
+			ThreeVector<float> center((a + b + c) / 3.f);
+			float edges[3] = {(b - a).getNorm(), (c - b).getNorm(), (a - c).getNorm()};
+
+			// Each point of the triangle is at most the longer edge at a corner away from it,
+			// and the distance from the mesh changes no faster than the point moves.
+			float bound = std::numeric_limits<float>::infinity();
+			float hint = bound, radius = .0f;
+
+			for (unsigned i = 0u; i != 3u; ++i)
+			{
+				float fromCenter = (*corners[i] - center).getNorm();
+
+				bound = std::min(bound, distances[i] + std::max(edges[i], edges[(i + 2u) % 3u]));
+				hint = std::min(hint, distances[i] + fromCenter);
+				radius = std::max(radius, fromCenter);
+				this->lowerBound = std::max(this->lowerBound, distances[i]);
+			}
+
+			float distance = this->getDistance(center, hint);
+			bound = std::min(bound, distance + radius);
+			this->lowerBound = std::max(this->lowerBound, distance);
+
+			if (bisections == 0u || bound <= this->lowerBound + this->tolerance)
+				return bound;
+
+			ThreeVector<float> ab((a + b) / 2.f), bc((b + c) / 2.f), ca((c + a) / 2.f);
+			const float middleDistances[3] = {
+				this->getDistance(ab, std::min(distances[0], distances[1]) + edges[0] / 2.f),
+				this->getDistance(bc, std::min(distances[1], distances[2]) + edges[1] / 2.f),
+				this->getDistance(ca, std::min(distances[2], distances[0]) + edges[2] / 2.f)};
+
+			const ThreeVector<float>* const quarters[4][3] = {
+				{&a, &ab, &ca}, {&ab, &b, &bc}, {&ca, &bc, &c}, {&ab, &bc, &ca}};
+			const float quarterDistances[4][3] = {
+				{distances[0], middleDistances[0], middleDistances[2]},
+				{middleDistances[0], distances[1], middleDistances[1]},
+				{middleDistances[2], middleDistances[1], distances[2]},
+				{middleDistances[0], middleDistances[1], middleDistances[2]}};
+
+			bound = .0f;
+			for (unsigned i = 0u; i != 4u; ++i)
+			{
+				bound = std::max(bound,
+					this->getDistance(quarters[i], quarterDistances[i], bisections - 1u));
+			}
+
+			return bound;
+		}
+	}
+
+	CollisionProxy::CollisionProxy(const Body::Pool& bodyPool,
+		const RigidBody::Pool& rigidBodyPool, ProxyType type, float cellSize) :
+		deviation{std::numeric_limits<float>::infinity()}
+	{
+		if (type == ProxyType::CONVEX_HULL)
+			this->buildHull(rigidBodyPool);
+		else
+			this->cluster(bodyPool, rigidBodyPool, cellSize);
+
+		this->surfaceNormals.resize(this->faces.size() / 3u);
+
+		this->bodyPool = Body::Pool{reinterpret_cast<unsigned(*)[3]>(this->faces.data()),
+			this->surfaceNormals.size()};
+		this->rigidBodyPool = RigidBody::Pool{this->vertices.data(),
+			this->surfaceNormals.data(), static_cast<unsigned>(this->vertices.size())};
+
+		computeSurfaceNormals(this->bodyPool, this->vertices.data(),
+			this->surfaceNormals.data());
+
+		// The vertices of a hull are vertices of the mesh; those of a clustered proxy are
+		// looked up like any other point.
+		DistanceBound distanceBound{bodyPool, rigidBodyPool,
+			deviationTolerance * getDiagonal(rigidBodyPool)};
+		std::vector<float> distances(this->vertices.size(), .0f);
+
+		if (type == ProxyType::CLUSTERED)
+		{
+			for (std::size_t i = 0; i != this->vertices.size(); ++i)
+			{
+				distances[i] = distanceBound.getDistance(this->vertices[i],
+					std::numeric_limits<float>::infinity());
+			}
+		}
+
+		float bound = .0f;
+		for (std::size_t i = 0; i != this->faces.size(); i += 3u)
+		{
+			const ThreeVector<float>* const corners[3] = {&this->vertices[this->faces[i]],
+				&this->vertices[this->faces[i + 1u]], &this->vertices[this->faces[i + 2u]]};
+			const float cornerDistances[3] = {distances[this->faces[i]],
+				distances[this->faces[i + 1u]], distances[this->faces[i + 2u]]};
+
+			bound = std::max(bound,
+				distanceBound.getDistance(corners, cornerDistances, maxBisections));
+		}
+
+		this->deviation = std::min(this->deviation, bound);
+	}
+
+	void CollisionProxy::buildHull(const RigidBody::Pool& pool)
+	{
+		const ThreeVector<float>* meshVertices = std::get<0>(pool);
+		std::vector<ThreeVector<double>> points;
+
+		for (unsigned i = 0u; i != std::get<2>(pool); ++i)
+			points.emplace_back(meshVertices[i][0], meshVertices[i][1], meshVertices[i][2]);
+
+		if (points.size() < 4u)
+			throw std::runtime_error{"CollisionProxy: mesh is flat"};
+
+		// Index of the point farthest from something.
+		auto getFarthest = [&points](auto getDistance) {
+			unsigned farthest = 0u;
+			for (unsigned i = 1u; i != points.size(); ++i)
+			{
+				if (getDistance(points[i]) > getDistance(points[farthest]))
+					farthest = i;
+			}
+			return farthest;
+		};
+
+		// Start with a tetrahedron of points far apart: the point with the least x
+		// coordinate, the one farthest from it, the one farthest from the line through
+		// these and the one farthest from the plane through all three.
+		unsigned a = getFarthest([](const ThreeVector<double>& point) {
+			return -point[0];
+		});
+		unsigned b = getFarthest([&](const ThreeVector<double>& point) {
+			return (point - points[a]).getNorm();
+		});
+		ThreeVector<double> axis((points[b] - points[a]).getUnitVector());
+		unsigned c = getFarthest([&](const ThreeVector<double>& point) {
+			return getCrossProduct(point - points[a], axis).getNorm();
+		});
+		HullFace base = makeHullFace(points, a, b, c);
+		unsigned d = getFarthest([&](const ThreeVector<double>& point) {
+			return std::abs(getHeight(base, point));
+		});
+
+		// Points closer than this to the plane of a face are taken to be on it.
+		const double epsilon = 1e-6 * (points[b] - points[a]).getNorm();
+
+		if (getCrossProduct(points[c] - points[a], axis).getNorm() <= epsilon ||
+			std::abs(getHeight(base, points[d])) <= epsilon)
+		{
+			throw std::runtime_error{"CollisionProxy: mesh is flat"};
+		}
+
+		std::vector<HullFace> hull;
+
+		// Wind each face so the fourth point is behind it.
+		const unsigned tetrahedron[4][4] = {{a, b, c, d}, {a, d, b, c}, {b, d, c, a},
+			{c, d, a, b}};
+
+		for (const auto& corners : tetrahedron)
+		{
+			hull.push_back(makeHullFace(points, corners[0], corners[1], corners[2]));
+			if (getHeight(hull.back(), points[corners[3]]) > .0)
+				hull.back() = makeHullFace(points, corners[0], corners[2], corners[1]);
+		}
+
+		// Add each point outside the hull: replace the faces it can see by a fan from it to
+		// the horizon, the edges of visible faces whose other face isn't visible.
+		std::set<std::pair<unsigned, unsigned>> visibleEdges;
+		std::vector<HullFace> nextHull;
+
+		for (unsigned i = 0u; i != points.size(); ++i)
+		{
+			visibleEdges.clear();
+
+			for (const auto& face : hull)
+			{
+				if (getHeight(face, points[i]) > epsilon)
+				{
+					for (unsigned j = 0u; j != 3u; ++j)
+						visibleEdges.emplace(face.corners[j], face.corners[(j + 1u) % 3u]);
+				}
+			}
+
+			if (visibleEdges.empty())
+				continue;
+
+			nextHull.clear();
+
+			for (const auto& face : hull)
+			{
+				if (getHeight(face, points[i]) <= epsilon)
+				{
+					nextHull.push_back(face);
+					continue;
+				}
+
+				for (unsigned j = 0u; j != 3u; ++j)
+				{
+					unsigned from = face.corners[j], to = face.corners[(j + 1u) % 3u];
+					if (!visibleEdges.count(std::make_pair(to, from)))
+						nextHull.push_back(makeHullFace(points, from, to, i));
+				}
+			}
+
+			hull.swap(nextHull);
+		}
+
+		// Keep only the vertices of the mesh the hull is made of.
+		std::vector<unsigned> indices(points.size(), none);
+
+		for (const auto& face : hull)
+		{
+			for (unsigned corner : face.corners)
+			{
+				if (indices[corner] == none)
+				{
+					indices[corner] = static_cast<unsigned>(this->vertices.size());
+					this->vertices.emplace_back(meshVertices[corner]);
+				}
+				this->faces.push_back(indices[corner]);
+			}
+		}
+	}
+
+	void CollisionProxy::cluster(const Body::Pool& bodyPool,
+		const RigidBody::Pool& rigidBodyPool, float cellSize)
+	{
+		if (!(cellSize > .0f))
+			throw std::runtime_error{"CollisionProxy: cells need a positive size"};
+
+		const ThreeVector<float>* meshVertices = std::get<0>(rigidBodyPool);
+		const unsigned vertexCount = std::get<2>(rigidBodyPool);
+
+		// Number the occupied cells and average the vertices in each.
+		std::map<std::array<long long, 3>, unsigned> cells;
+		std::vector<unsigned> clusters(vertexCount);
+		std::vector<ThreeVector<double>> sums;
+		std::vector<unsigned> counts;
+
+		for (unsigned i = 0u; i != vertexCount; ++i)
+		{
+			const ThreeVector<float>& vertex = meshVertices[i];
+			std::array<long long, 3> cell;
+
+			for (unsigned j = 0u; j != 3u; ++j)
+				cell[j] = static_cast<long long>(std::floor(vertex[j] / cellSize));
+
+			auto inserted = cells.emplace(cell, static_cast<unsigned>(sums.size()));
+			if (inserted.second)
+			{
+				sums.emplace_back(.0, .0, .0);
+				counts.push_back(0u);
+			}
+
+			clusters[i] = inserted.first->second;
+			sums[clusters[i]] += ThreeVector<double>(vertex[0], vertex[1], vertex[2]);
+			++counts[clusters[i]];
+		}
+
+		std::vector<ThreeVector<float>> means;
+
+		for (unsigned i = 0u; i != sums.size(); ++i)
+		{
+			ThreeVector<double> mean(sums[i] / static_cast<double>(counts[i]));
+			means.emplace_back(static_cast<float>(mean[0]), static_cast<float>(mean[1]),
+				static_cast<float>(mean[2]));
+		}
+
+		// Keep each triangle that doesn't collapse, once.
+		std::set<std::array<unsigned, 3>> kept;
+		std::vector<unsigned> indices(means.size(), none);
+
+		for (std::size_t i = 0; i != std::get<1>(bodyPool); ++i)
+		{
+			const unsigned (& face)[3] = std::get<0>(bodyPool)[i];
+			std::array<unsigned, 3> corners{{clusters[face[0]], clusters[face[1]],
+				clusters[face[2]]}};
+
+			if (getCrossProduct(means[corners[1]] - means[corners[0]],
+				means[corners[2]] - means[corners[0]]).getNorm() == .0f)
+			{
+				continue;
+			}
+
+			std::array<unsigned, 3> key(corners);
+			std::sort(key.begin(), key.end());
+			if (!kept.insert(key).second)
+				continue;
+
+			for (unsigned corner : corners)
+			{
+				if (indices[corner] == none)
+				{
+					indices[corner] = static_cast<unsigned>(this->vertices.size());
+					this->vertices.emplace_back(means[corner]);
+				}
+				this->faces.push_back(indices[corner]);
+			}
+		}
+
+		if (this->faces.empty())
+			throw std::runtime_error{"CollisionProxy: cells too large, no triangles left"};
+
+		// Each point of a kept triangle is as far from the corresponding point of the
+		// original triangle as its corners are at most.
+		this->deviation = .0f;
+
+		for (unsigned i = 0u; i != vertexCount; ++i)
+		{
+			this->deviation = std::max(this->deviation,
+				(meshVertices[i] - means[clusters[i]]).getNorm());
+		}
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
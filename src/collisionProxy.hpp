@@ -0,0 +1,91 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COLLISIONPROXY_HPP_SEEN
+#define COLLISIONPROXY_HPP_SEEN
+
+#include <vector>
+
+#include "body.hpp"
+#include "rigidBody.hpp"
+#include "threeVector.hpp"
+
+namespace nut
+{
+	enum class ProxyType : unsigned char
+	{
+		CONVEX_HULL, // the smallest convex mesh that contains all vertices
+		CLUSTERED // vertices in the same cell of a grid merged into their mean
+	};
+
+	// A simplified mesh to collide as in place of a detailed one, e.g. as a coarser level
+	// of detail; see RigidBody::RigidBody(…, const std::vector<CollisionLevel>&).  Built
+	// offline, by nutsimplify, or at load time.
+	//
+	// Its deviation is an upper bound of how far any point of its surface is from the
+	// surface of the original mesh.  It's found by bisecting the triangles of the proxy a
+	// few times, or until it's within 1% of the size of the mesh of the actual distance.  A
+	// convex hull also contains the original mesh, so it misses no collisions and only
+	// reports some early.
+	//
+	// Owns the arrays the pools point to and has to outlive all bodies constructed from it.
+	class CollisionProxy
+	{
+		public:
+
+		CollisionProxy() = delete;
+		CollisionProxy(const CollisionProxy&) = delete;
+
+		// cellSize is the length of the edges of the grid of a CLUSTERED proxy and ignored
+		// for a convex hull.  Throws std::runtime_error if the mesh is flat, for a hull, or
+		// cellSize isn't positive, for a clustered one.
+		CollisionProxy(const Body::Pool&, const RigidBody::Pool&, ProxyType,
+			float cellSize = .0f);
+
+		~CollisionProxy() = default;
+
+		CollisionProxy& operator=(const CollisionProxy&) = delete;
+
+		const Body::Pool& getBodyPool() const { return this->bodyPool; }
+
+		const RigidBody::Pool& getRigidBodyPool() const { return this->rigidBodyPool; }
+
+		float getDeviation() const { return this->deviation; }
+
+		CollisionLevel getCollisionLevel() const {
+			return CollisionLevel{&this->bodyPool, &this->rigidBodyPool, this->deviation};
+		}
+
+		private:
+
+		// Fill faces and vertices.
+		void buildHull(const RigidBody::Pool&);
+		void cluster(const Body::Pool&, const RigidBody::Pool&, float cellSize);
+
+		std::vector<unsigned> faces; // three indices per triangle
+		std::vector<ThreeVector<float>> vertices;
+		std::vector<ThreeVector<float>> surfaceNormals;
+
+		Body::Pool bodyPool;
+		RigidBody::Pool rigidBodyPool;
+
+		float deviation;
+	};
+}
+
+#endif //COLLISIONPROXY_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
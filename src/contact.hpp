@@ -0,0 +1,70 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONTACT_HPP_SEEN
+#define CONTACT_HPP_SEEN
+
+#include <cstdint>
+
+#include "ringBuffer.hpp"
+#include "threeVector.hpp"
+
+namespace nut
+{
+	class Heightfield;
+	class RigidBody;
+	class StaticBody;
+
+	// Two bodies collide if the layers of each share a bit with the mask of the other.  Put
+	// debris on a layer of its own and leave that out of its mask, and pieces of debris
+	// won't collide with each other.  Pairs that don't collide aren't tested at all.
+	struct CollisionFilter
+	{
+		std::uint32_t layers = 1u;
+		std::uint32_t mask = 0xFFFFFFFFu;
+	};
+
+	inline bool doCollide(const CollisionFilter& first, const CollisionFilter& second)
+	{
+		return (first.layers & second.mask) && (second.layers & first.mask);
+	}
+
+	enum class ContactType : unsigned char
+	{
+		BEGIN, // The bodies collided in this step but not in the one before.
+		PERSIST, // They collided in both.
+		END // They collided in the step before but not in this one.
+	};
+
+	// A change in what a rigid body touches, reported once per step and pair.
+	struct ContactEvent
+	{
+		ContactType type;
+		const RigidBody* bodies[2]; // The second one is nullptr if the first hit an obstacle.
+		const StaticBody* staticBody; // the obstacle, if it's one
+		const Heightfield* heightfield; // the obstacle, if it's one
+		ThreeVector<float> point; // of the first collision in the step
+		ThreeVector<float> normal; // at that point; its sign is unspecified
+	};
+
+	// Events of all steps that haven't been drained yet, oldest first.  Filled by
+	// advanceState, e.g. on the thread of a Stepper, and drained by another thread at most.
+	extern RingBuffer<ContactEvent> contactEvents;
+}
+
+#endif //CONTACT_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,217 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cookedMesh.hpp"
+
+namespace nut
+{
+	// The pools are used in place, so the file's sections have to look exactly like the
+	// arrays they stand in for.
+	static_assert(sizeof(unsigned) == sizeof(std::uint32_t), "unexpected size of unsigned");
+	static_assert(sizeof(ThreeVector<float>) == 3u * sizeof(float),
+		"ThreeVector<float> is padded");
+	static_assert(cookedMeshAlignment % alignof(CookedMeshHeader) == 0u,
+		"misaligned header");
+
+	namespace
+	{
+		const char magic[8] = {'N', 'U', 'T', 'M', 'E', 'S', 'H', '\0'};
+
+		std::size_t align(std::size_t offset)
+		{
+			return (offset + cookedMeshAlignment - 1u) / cookedMeshAlignment *
+				cookedMeshAlignment;
+		}
+
+		// Is [offset, offset + count * elementSize) aligned and inside the file?
+		bool isSection(std::uint64_t offset, std::uint64_t count, std::size_t elementSize,
+			std::size_t fileSize)
+		{
+			return offset % cookedMeshAlignment == 0u && offset <= fileSize &&
+				count <= (fileSize - offset) / elementSize;
+		}
+	}
+
+	CookedMesh::CookedMesh(const char* fileName) : mapping{nullptr}, mappingSize{0u}
+	{
+		int fileDescriptor = ::open(fileName, O_RDONLY | O_CLOEXEC);
+		if (fileDescriptor == -1)
+			throw std::runtime_error{std::string{"can't open "} + fileName};
+
+		struct stat status;
+		if (::fstat(fileDescriptor, &status) == -1 ||
+			static_cast<std::size_t>(status.st_size) < sizeof(CookedMeshHeader))
+		{
+			::close(fileDescriptor);
+			throw std::runtime_error{std::string{fileName} + " is no cooked mesh"};
+		}
+
+		this->mappingSize = static_cast<std::size_t>(status.st_size);
+		this->mapping = ::mmap(nullptr, this->mappingSize, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE, fileDescriptor, 0);
+		::close(fileDescriptor); // The mapping keeps its own reference to the file.
+
+		if (this->mapping == MAP_FAILED)
+			throw std::runtime_error{std::string{"can't map "} + fileName};
+
+		// Start reading the whole file in; it will all be touched soon anyway.
+		::madvise(this->mapping, this->mappingSize, MADV_WILLNEED);
+
+		const CookedMeshHeader& header = this->getHeader();
+
+		if (std::memcmp(header.magic, magic, sizeof magic) != 0 ||
+			header.version != cookedMeshVersion ||
+			header.vertexCount > UINT32_MAX || header.triangleCount > UINT32_MAX ||
+			!isSection(header.faceOffset, header.triangleCount, 3u * sizeof(std::uint32_t),
+			           this->mappingSize) ||
+			!isSection(header.vertexOffset, header.vertexCount, sizeof(ThreeVector<float>),
+			           this->mappingSize) ||
+			!isSection(header.normalOffset, header.triangleCount, sizeof(ThreeVector<float>),
+			           this->mappingSize) ||
+			(header.flags & cookedMeshHasAcceleration &&
+			 !isSection(header.accelerationOffset, header.accelerationSize, 1u,
+			            this->mappingSize)))
+		{
+			::munmap(this->mapping, this->mappingSize);
+			throw std::runtime_error{std::string{fileName} +
+				" is no cooked mesh of version " + std::to_string(cookedMeshVersion)};
+		}
+
+		char* base = static_cast<char*>(this->mapping);
+
+		// Bodies index vertices by the faces without checking, so check them once here.
+		const std::uint32_t* faceIndices =
+			reinterpret_cast<const std::uint32_t*>(base + header.faceOffset);
+
+		if (std::any_of(faceIndices, faceIndices + 3u * header.triangleCount,
+			[&header](std::uint32_t index) { return index >= header.vertexCount; }))
+		{
+			::munmap(this->mapping, this->mappingSize);
+			throw std::runtime_error{std::string{fileName} +
+				" has faces with vertices that aren't in it"};
+		}
+
+		this->bodyPool = Body::Pool{
+			reinterpret_cast<unsigned(*)[3]>(base + header.faceOffset),
+			header.triangleCount};
+
+		this->rigidBodyPool = RigidBody::Pool{
+			reinterpret_cast<ThreeVector<float>*>(base + header.vertexOffset),
+			reinterpret_cast<ThreeVector<float>*>(base + header.normalOffset),
+			static_cast<unsigned>(header.vertexCount)};
+	}
+
+	CookedMesh::~CookedMesh()
+	{
+		::munmap(this->mapping, this->mappingSize);
+	}
+
+	const void* CookedMesh::getAccelerationData() const
+	{
+		if (!(this->getHeader().flags & cookedMeshHasAcceleration))
+			return nullptr;
+
+		return static_cast<const char*>(this->mapping) +
+			this->getHeader().accelerationOffset;
+	}
+
+	void cookMesh(const char* fileName, const Body::Pool& bodyPool,
+		const RigidBody::Pool& rigidBodyPool, const void* accelerationData,
+		std::size_t accelerationSize, float deviation)
+	{
+		CookedMeshHeader header{};
+
+		std::copy(magic, magic + sizeof magic, header.magic);
+		header.version = cookedMeshVersion;
+		header.flags = cookedMeshHasBounds;
+		header.triangleCount = std::get<1>(bodyPool);
+		header.vertexCount = std::get<2>(rigidBodyPool);
+		header.deviation = deviation;
+
+		header.faceOffset = align(sizeof header);
+		header.vertexOffset = align(header.faceOffset +
+			header.triangleCount * 3u * sizeof(std::uint32_t));
+		header.normalOffset = align(header.vertexOffset +
+			header.vertexCount * sizeof(ThreeVector<float>));
+
+		std::size_t end = header.normalOffset +
+			header.triangleCount * sizeof(ThreeVector<float>);
+
+		if (accelerationData)
+		{
+			header.flags |= cookedMeshHasAcceleration;
+			header.accelerationOffset = align(end);
+			header.accelerationSize = accelerationSize;
+			end = header.accelerationOffset + accelerationSize;
+		}
+
+		const ThreeVector<float>* vertices = std::get<0>(rigidBodyPool);
+
+		for (std::size_t i = 0; i != 3u; ++i)
+		{
+			header.boundsMin[i] = header.vertexCount ? vertices[0][i] : .0f;
+			header.boundsMax[i] = header.boundsMin[i];
+		}
+
+		for (std::size_t i = 0; i != header.vertexCount; ++i)
+		{
+			for (std::size_t j = 0; j != 3u; ++j)
+			{
+				header.boundsMin[j] = std::min(header.boundsMin[j], vertices[i][j]);
+				header.boundsMax[j] = std::max(header.boundsMax[j], vertices[i][j]);
+			}
+			header.boundingRadius = std::max(header.boundingRadius, vertices[i].getNorm());
+		}
+
+		std::ofstream file{fileName, std::ios::binary | std::ios::trunc};
+
+		// Write a section and pad the file up to the next one.
+		auto write = [&file](std::size_t offset, const void* data, std::size_t size) {
+			const char zeros[cookedMeshAlignment] = {};
+			std::size_t position = static_cast<std::size_t>(file.tellp());
+			file.write(zeros, static_cast<std::streamsize>(offset - position));
+			file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		};
+
+		write(0u, &header, sizeof header);
+		write(header.faceOffset, std::get<0>(bodyPool),
+			header.triangleCount * 3u * sizeof(std::uint32_t));
+		write(header.vertexOffset, vertices, header.vertexCount * sizeof(ThreeVector<float>));
+		write(header.normalOffset, std::get<1>(rigidBodyPool),
+			header.triangleCount * sizeof(ThreeVector<float>));
+		if (accelerationData)
+			write(header.accelerationOffset, accelerationData, accelerationSize);
+
+		file.flush();
+		if (!file || static_cast<std::size_t>(file.tellp()) != end)
+			throw std::runtime_error{std::string{"can't write "} + fileName};
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
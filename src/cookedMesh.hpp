@@ -0,0 +1,111 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COOKEDMESH_HPP_SEEN
+#define COOKEDMESH_HPP_SEEN
+
+#include <cstddef> // std::size_t
+#include <cstdint>
+
+#include "body.hpp"
+#include "rigidBody.hpp"
+
+namespace nut
+{
+	// Current version of the cooked mesh format.  Files of any other version are rejected.
+	constexpr std::uint32_t cookedMeshVersion = 1u;
+
+	// Every section of a cooked mesh file starts at a multiple of this many bytes.
+	constexpr std::size_t cookedMeshAlignment = 64u;
+
+	// Bits of CookedMeshHeader::flags.
+	constexpr std::uint32_t cookedMeshHasBounds       = 1u;
+	constexpr std::uint32_t cookedMeshHasAcceleration = 2u;
+
+	// Layout of the beginning of a cooked mesh file.  Numbers are stored in the byte order of
+	// the machine that cooked the file; offsets are counted in bytes from the start of the
+	// file.
+	struct CookedMeshHeader
+	{
+		char magic[8]; // "NUTMESH" followed by a null character
+		std::uint32_t version;
+		std::uint32_t flags;
+		std::uint64_t triangleCount;
+		std::uint64_t vertexCount;
+		std::uint64_t faceOffset;   // triangleCount triples of 32-bit indices
+		std::uint64_t vertexOffset; // vertexCount triples of floats in object coordinates
+		std::uint64_t normalOffset; // triangleCount triples of floats in object coordinates
+		std::uint64_t accelerationOffset;
+		std::uint64_t accelerationSize;
+		float boundsMin[3];
+		float boundsMax[3];
+		float boundingRadius; // of a sphere around the origin of object coordinates
+		float deviation; // from the mesh it simplifies, 0 for others; see CollisionProxy
+	};
+
+	// A cooked mesh file mapped into memory.  The pools point right into the mapping, which
+	// is private: changes made through them never reach the file and pages are only copied
+	// when written to.  Bodies keep references to the pools, so a CookedMesh has to outlive
+	// all bodies constructed from it.
+	class CookedMesh
+	{
+		public:
+
+		CookedMesh() = delete;
+		CookedMesh(const CookedMesh&) = delete;
+		// Throws std::runtime_error if the file isn't a cooked mesh, its sections don't fit
+		// in it or its faces refer to vertices it doesn't have.
+		explicit CookedMesh(const char* fileName);
+
+		~CookedMesh();
+
+		CookedMesh& operator=(const CookedMesh&) = delete;
+
+		const Body::Pool& getBodyPool() const { return this->bodyPool; }
+
+		const RigidBody::Pool& getRigidBodyPool() const { return this->rigidBodyPool; }
+
+		CollisionLevel getCollisionLevel() const {
+			return CollisionLevel{&this->bodyPool, &this->rigidBodyPool,
+				this->getHeader().deviation};
+		}
+
+		const CookedMeshHeader& getHeader() const {
+			return *static_cast<const CookedMeshHeader*>(this->mapping);
+		}
+
+		// Returns nullptr if the file holds no acceleration data.
+		const void* getAccelerationData() const;
+
+		private:
+
+		void* mapping;
+		std::size_t mappingSize;
+
+		Body::Pool bodyPool;
+		RigidBody::Pool rigidBodyPool;
+	};
+
+	// Write the geometry of the pools to a cooked mesh file, along with its bounds and the
+	// optional, opaque acceleration data.  Throws std::runtime_error on failure.
+	void cookMesh(const char* fileName, const Body::Pool&, const RigidBody::Pool&,
+		const void* accelerationData = nullptr, std::size_t accelerationSize = 0u,
+		float deviation = .0f);
+}
+
+#endif //COOKEDMESH_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
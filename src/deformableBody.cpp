@@ -0,0 +1,515 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "deformableBody.hpp"
+#include "geometryArena.hpp"
+#include "parallel.hpp"
+#include "shape.hpp"
+
+namespace nut
+{
+	unsigned short solverIterations = 8u;
+	unsigned solverThreadCount = 0u;
+
+	namespace
+	{
+		// Constraints per thread and batch at least; below that, waiting for each other
+		// takes longer than the work.
+		const unsigned minimumShare = 2048u;
+
+		// constraints solved at a time with SSE2
+		constexpr unsigned batchSize = 4u;
+
+		// kept from substep to substep
+		ThreadPool threadPool;
+	}
+
+	std::vector<DeformableBody*> DeformableBody::deformableBodies;
+
+	DeformableBody::DeformableBody(const ModelViewMatrix<float>& modelViewMatrix,
+		const Body::Pool& bodyPool, const RigidBody::Pool& rigidBodyPool, float mass,
+		float compliance, float thickness) :
+			Body{nullptr, nullptr, bodyPool}, vertexCount{std::get<2>(rigidBodyPool)},
+			compliance{compliance}, thickness{thickness},
+			tree{std::get<0>(bodyPool), std::get<1>(bodyPool),
+			     DeformableBody::transform(*this, modelViewMatrix, rigidBodyPool)}
+	{
+		for (int i = 0; i != 3; ++i)
+		{
+			this->position[i].resize(this->vertexCount);
+			this->previousPosition[i].resize(this->vertexCount);
+			this->velocity[i].assign(this->vertexCount, .0f);
+
+			for (unsigned j = 0; j != this->vertexCount; ++j)
+				this->position[i][j] = this->vertices[j][i];
+		}
+
+		this->inverseMass.assign(this->vertexCount, this->vertexCount / mass);
+
+		// one constraint per edge
+		std::vector<std::pair<unsigned, unsigned>> edges;
+
+		for (unsigned i = 0; i != this->getTriangleCount(); ++i)
+		{
+			for (unsigned j = 0; j != 3u; ++j)
+			{
+				unsigned first = this->getFaces()[i][j];
+				unsigned second = this->getFaces()[i][(j + 1u) % 3u];
+				edges.emplace_back(std::min(first, second), std::max(first, second));
+			}
+		}
+
+		std::sort(edges.begin(), edges.end());
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+		// Greedy colouring: each edge gets the lowest colour that none of the edges at its
+		// particles has yet.
+		std::vector<std::uint64_t> usedColours(this->vertexCount);
+		std::vector<unsigned> colours(edges.size());
+
+		for (std::size_t i = 0; i != edges.size(); ++i)
+		{
+			std::uint64_t used = usedColours[edges[i].first] | usedColours[edges[i].second];
+			if (~used == 0u)
+				throw std::runtime_error{"DeformableBody: too many edges at one vertex"};
+
+			unsigned colour = 0u;
+			while (used >> colour & 1u)
+				++colour;
+
+			colours[i] = colour;
+			usedColours[edges[i].first] |= std::uint64_t{1u} << colour;
+			usedColours[edges[i].second] |= std::uint64_t{1u} << colour;
+		}
+
+		// Sort the constraints by colour.
+		unsigned colourCount = edges.empty() ? 0u :
+			*std::max_element(colours.begin(), colours.end()) + 1u;
+
+		this->batches.assign(colourCount + 1u, 0u);
+		for (unsigned colour : colours)
+			++this->batches[colour + 1u];
+		std::partial_sum(this->batches.begin(), this->batches.end(), this->batches.begin());
+
+		this->constrained[0].resize(edges.size());
+		this->constrained[1].resize(edges.size());
+		this->restLength.resize(edges.size());
+		this->lambda.resize(edges.size());
+
+		std::vector<unsigned> next(this->batches.begin(), this->batches.end() - 1);
+
+		for (std::size_t i = 0; i != edges.size(); ++i)
+		{
+			unsigned j = next[colours[i]]++;
+
+			this->constrained[0][j] = edges[i].first;
+			this->constrained[1][j] = edges[i].second;
+			this->restLength[j] = (this->vertices[edges[i].first] -
+				this->vertices[edges[i].second]).getNorm();
+		}
+
+		DeformableBody::deformableBodies.push_back(this);
+	}
+
+	DeformableBody::~DeformableBody()
+	{
+		DeformableBody::deformableBodies.erase(std::find(
+			DeformableBody::deformableBodies.begin(), DeformableBody::deformableBodies.end(),
+			this));
+
+		GeometryArena::release(*this);
+	}
+
+	void DeformableBody::pin(unsigned vertex)
+	{
+		this->inverseMass[vertex] = .0f;
+
+		for (int i = 0; i != 3; ++i)
+			this->velocity[i][vertex] = .0f;
+	}
+
+	const ThreeVector<float>* DeformableBody::transform(DeformableBody& body,
+		const ModelViewMatrix<float>& modelViewMatrix, const RigidBody::Pool& pool)
+	{
+		GeometryArena::allocate(body, std::get<2>(pool), body.getTriangleCount());
+
+		for (unsigned i = 0; i != std::get<2>(pool); ++i)
+		{
+			body.vertices[i] = modelViewMatrix *
+				static_cast<ThreeVector<float, VERTEX>&>(std::get<0>(pool)[i]);
+		}
+
+		computeSurfaceNormals(*body.pool, body.vertices, body.surfaceNormals);
+
+		return body.vertices;
+	}
+
+	void DeformableBody::advanceState(float timeInterval)
+	{
+		for (auto i : DeformableBody::deformableBodies)
+			i->advance(timeInterval);
+	}
+
+	void DeformableBody::advance(float timeInterval)
+	{
+		const unsigned vertexCount = this->vertexCount;
+		const float* inverseMass = this->inverseMass.data();
+
+		// Predict positions.  Here and below, the loops run over plain arrays of one
+		// coordinate each so the compiler can vectorize them.
+		for (int i = 0; i != 3; ++i)
+		{
+			float* position = this->position[i].data();
+			float* previousPosition = this->previousPosition[i].data();
+			float* velocity = this->velocity[i].data();
+			const float velocityAddend = this->acceleration[i] * timeInterval;
+
+			for (unsigned j = 0; j < vertexCount; ++j)
+			{
+				previousPosition[j] = position[j];
+				velocity[j] += inverseMass[j] != .0f ? velocityAddend : .0f;
+				position[j] += velocity[j] * timeInterval;
+			}
+		}
+
+		std::fill(this->lambda.begin(), this->lambda.end(), .0f);
+
+		// Batches hold constraints of one colour, which share no particles; threads split
+		// each batch between them and wait for each other before going on to the next one.
+		unsigned threadCount = solverThreadCount ? solverThreadCount :
+			std::max(std::thread::hardware_concurrency(), 1u);
+		threadCount = std::min(threadCount,
+			static_cast<unsigned>(this->restLength.size()) / minimumShare + 1u);
+
+		if (threadCount == 1u)
+		{
+			for (unsigned short i = 0u; i != solverIterations; ++i)
+			{
+				for (std::size_t j = 0; j + 1u < this->batches.size(); ++j)
+					this->project(this->batches[j], this->batches[j + 1u], timeInterval);
+			}
+		}
+		else
+		{
+			Barrier barrier{threadCount};
+
+			threadPool.run(threadCount, [&](unsigned thread) {
+				for (unsigned short i = 0u; i != solverIterations; ++i)
+				{
+					for (std::size_t j = 0; j + 1u < this->batches.size(); ++j)
+					{
+						unsigned size = this->batches[j + 1u] - this->batches[j];
+
+						this->project(this->batches[j] + size * thread / threadCount,
+							this->batches[j] + size * (thread + 1u) / threadCount, timeInterval);
+
+						barrier.wait();
+					}
+				}
+			});
+		}
+
+		this->collide(timeInterval);
+
+		for (int i = 0; i != 3; ++i)
+		{
+			const float* position = this->position[i].data();
+			const float* previousPosition = this->previousPosition[i].data();
+			float* velocity = this->velocity[i].data();
+
+			for (unsigned j = 0; j < vertexCount; ++j)
+				velocity[j] = (position[j] - previousPosition[j]) / timeInterval;
+		}
+
+		for (unsigned i = 0; i != vertexCount; ++i)
+		{
+			this->vertices[i] = ThreeVector<float>{
+				this->position[0][i], this->position[1][i], this->position[2][i]};
+		}
+
+		computeSurfaceNormals(*this->pool, this->vertices, this->surfaceNormals);
+
+		this->tree.refit(this->getFaces(), this->vertices);
+	}
+
+	void DeformableBody::project(unsigned begin, unsigned end, float timeInterval)
+	{
+		float* x = this->position[0].data();
+		float* y = this->position[1].data();
+		float* z = this->position[2].data();
+		const float* inverseMass = this->inverseMass.data();
+		const unsigned* first = this->constrained[0].data();
+		const unsigned* second = this->constrained[1].data();
+		const float* restLength = this->restLength.data();
+		float* lambda = this->lambda.data();
+
+		// compliance scaled to the substep
+		const float alpha = this->compliance / (timeInterval * timeInterval);
+
+		unsigned i = begin;
+
+#ifdef __SSE2__
+		// Four at a time.  The constraints share no particles, so the coordinates and inverse
+		// masses of their ends are gathered into arrays by coordinate, and the new positions
+		// scattered back.  Constraints skipped below get a correction of zero instead.
+		const __m128 alphas = _mm_set1_ps(alpha);
+		const __m128 zero = _mm_setzero_ps();
+
+		for (; i + batchSize <= end; i += batchSize)
+		{
+			const unsigned* const particles[2] = {first + i, second + i};
+			alignas(16) float ends[2][4][batchSize]; // x, y, z and inverse mass
+
+			for (int side = 0; side != 2; ++side)
+			{
+				for (unsigned j = 0; j != batchSize; ++j)
+				{
+					ends[side][0][j] = x[particles[side][j]];
+					ends[side][1][j] = y[particles[side][j]];
+					ends[side][2][j] = z[particles[side][j]];
+					ends[side][3][j] = inverseMass[particles[side][j]];
+				}
+			}
+
+			__m128 difference[3];
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				difference[axis] = _mm_sub_ps(_mm_load_ps(ends[0][axis]),
+					_mm_load_ps(ends[1][axis]));
+			}
+
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(difference[0], difference[0]),
+				_mm_mul_ps(difference[1], difference[1])),
+				_mm_mul_ps(difference[2], difference[2])));
+
+			const __m128 inverseMasses[2] = {_mm_load_ps(ends[0][3]), _mm_load_ps(ends[1][3])};
+			__m128 weight = _mm_add_ps(_mm_add_ps(inverseMasses[0], inverseMasses[1]), alphas);
+			__m128 isSkipped = _mm_or_ps(_mm_cmpeq_ps(length, zero),
+				_mm_cmpeq_ps(weight, zero));
+
+			__m128 lambdas = _mm_loadu_ps(lambda + i);
+			__m128 lambdaAddend = _mm_andnot_ps(isSkipped, _mm_div_ps(_mm_sub_ps(_mm_sub_ps(
+				_mm_loadu_ps(restLength + i), length), _mm_mul_ps(alphas, lambdas)), weight));
+			_mm_storeu_ps(lambda + i, _mm_add_ps(lambdas, lambdaAddend));
+
+			__m128 scale = _mm_andnot_ps(isSkipped, _mm_div_ps(lambdaAddend, length));
+			const __m128 scales[2] = {_mm_mul_ps(inverseMasses[0], scale),
+				_mm_mul_ps(inverseMasses[1], scale)};
+
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				_mm_store_ps(ends[0][axis], _mm_add_ps(_mm_load_ps(ends[0][axis]),
+					_mm_mul_ps(scales[0], difference[axis])));
+				_mm_store_ps(ends[1][axis], _mm_sub_ps(_mm_load_ps(ends[1][axis]),
+					_mm_mul_ps(scales[1], difference[axis])));
+			}
+
+			for (int side = 0; side != 2; ++side)
+			{
+				for (unsigned j = 0; j != batchSize; ++j)
+				{
+					x[particles[side][j]] = ends[side][0][j];
+					y[particles[side][j]] = ends[side][1][j];
+					z[particles[side][j]] = ends[side][2][j];
+				}
+			}
+		}
+#endif
+
+		for (; i < end; ++i)
+		{
+			unsigned j = first[i], k = second[i];
+
+			float difference[3] = {x[j] - x[k], y[j] - y[k], z[j] - z[k]};
+			float length = std::sqrt(difference[0] * difference[0] +
+				difference[1] * difference[1] + difference[2] * difference[2]);
+
+			float weight = inverseMass[j] + inverseMass[k] + alpha;
+			if (length == .0f || weight == .0f)
+				continue;
+
+			float lambdaAddend = (restLength[i] - length - alpha * lambda[i]) / weight;
+			lambda[i] += lambdaAddend;
+
+			float scale = lambdaAddend / length;
+
+			x[j] += inverseMass[j] * scale * difference[0];
+			y[j] += inverseMass[j] * scale * difference[1];
+			z[j] += inverseMass[j] * scale * difference[2];
+
+			x[k] -= inverseMass[k] * scale * difference[0];
+			y[k] -= inverseMass[k] * scale * difference[1];
+			z[k] -= inverseMass[k] * scale * difference[2];
+		}
+	}
+
+	void DeformableBody::collide(float timeInterval)
+	{
+		AxisAlignedBox bounds = getEmptyBox();
+		for (unsigned i = 0; i != this->vertexCount; ++i)
+		{
+			const float point[3] = {
+				this->position[0][i], this->position[1][i], this->position[2][i]};
+			grow(bounds, point);
+		}
+
+		for (auto body : RigidBody::rigidBodies)
+		{
+			if (!doCollide(this->collisionFilter, body->collisionFilter))
+				continue;
+
+			AxisAlignedBox box = getEmptyBox();
+
+			if (body->shape.type == ShapeType::MESH)
+			{
+				for (unsigned i = 0; i != body->getVertexCount(); ++i)
+					grow(box, body->vertices[i]);
+			}
+			else
+			{
+				box = nut::getBounds(body->shape, body->getObjectMatrix());
+			}
+
+			for (int i = 0; i != 3; ++i)
+			{
+				box.min[i] -= this->thickness;
+				box.max[i] += this->thickness;
+			}
+
+			if (!doOverlap(box, bounds))
+				continue;
+
+			const float bodyInverseMass = 1.f / body->mass;
+
+			// how far the particles have pushed the body so far; points are moved the other
+			// way instead of the body while testing
+			ThreeVector<float> displacement{.0f, .0f, .0f};
+
+			for (unsigned i = 0; i != this->vertexCount; ++i)
+			{
+				if (this->inverseMass[i] == .0f)
+					continue;
+
+				ThreeVector<float> point{this->position[0][i] - displacement[0],
+					this->position[1][i] - displacement[1],
+					this->position[2][i] - displacement[2]};
+
+				if (point[0] < box.min[0] || point[0] > box.max[0] ||
+					point[1] < box.min[1] || point[1] > box.max[1] ||
+					point[2] < box.min[2] || point[2] > box.max[2])
+				{
+					continue;
+				}
+
+				ThreeVector<float> normal;
+				float depth;
+
+				if (!DeformableBody::getPenetration(*body, point, this->thickness, normal,
+					depth))
+				{
+					continue;
+				}
+
+				// Split the correction in inverse proportion to the masses.
+				float share = this->inverseMass[i] / (this->inverseMass[i] + bodyInverseMass);
+
+				for (int j = 0; j != 3; ++j)
+					this->position[j][i] += share * depth * normal[j];
+
+				displacement -= (1.f - share) * depth * normal;
+			}
+
+			if (displacement * displacement != .0f)
+			{
+				body->getObjectMatrix()[12] += displacement[0];
+				body->getObjectMatrix()[13] += displacement[1];
+				body->getObjectMatrix()[14] += displacement[2];
+				body->velocity += displacement / timeInterval;
+				body->transform();
+			}
+		}
+	}
+
+	bool DeformableBody::getPenetration(const RigidBody& body,
+		const ThreeVector<float>& point, float distance, ThreeVector<float>& normal,
+		float& depth)
+	{
+		if (body.shape.type != ShapeType::MESH)
+		{
+			return nut::getPenetration(body.shape, body.getObjectMatrix(), point, distance,
+				normal, depth);
+		}
+
+		float leastDistanceSquared = std::numeric_limits<float>::infinity();
+		ThreeVector<float> closestPoint{.0f, .0f, .0f};
+		unsigned closestTriangle = 0u;
+
+		for (unsigned i = 0; i != body.getTriangleCount(); ++i)
+		{
+			const ThreeVector<float>* const corners[3] = {
+				&body.vertices[body.getFaces()[i][0]],
+				&body.vertices[body.getFaces()[i][1]],
+				&body.vertices[body.getFaces()[i][2]]};
+
+			ThreeVector<float> candidate(nut::getClosestPoint(corners, point));
+			ThreeVector<float> difference(point - candidate);
+
+			if (difference * difference < leastDistanceSquared)
+			{
+				leastDistanceSquared = difference * difference;
+				closestPoint = candidate;
+				closestTriangle = i;
+			}
+		}
+
+		if (leastDistanceSquared == std::numeric_limits<float>::infinity())
+			return false;
+
+		ThreeVector<float> difference(point - closestPoint);
+		float length = std::sqrt(leastDistanceSquared);
+
+		if (difference * body.surfaceNormals[closestTriangle] < .0f)
+		{
+			normal = body.surfaceNormals[closestTriangle];
+			depth = length + distance;
+			return true;
+		}
+
+		if (length >= distance)
+			return false;
+
+		normal = length == .0f ? ThreeVector<float>(body.surfaceNormals[closestTriangle]) :
+			difference / length;
+		depth = distance - length;
+		return true;
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
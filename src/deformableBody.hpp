@@ -1,3 +1,141 @@
-// TODO?
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DEFORMABLEBODY_HPP_SEEN
+#define DEFORMABLEBODY_HPP_SEEN
+
+#include <vector>
+
+#include "axisAlignedBox.hpp"
+#include "body.hpp"
+#include "contact.hpp"
+#include "modelViewMatrix.hpp"
+#include "rigidBody.hpp"
+#include "triangleTree.hpp"
+
+namespace nut
+{
+	// A soft body, e.g. cloth or padding.  Its vertices are particles held together by
+	// distance constraints along the edges of its triangles, solved by extended
+	// position-based dynamics (XPBD) once per substep of RigidBody::advanceState.
+	//
+	// Constraints are coloured so that no two of the same colour share a particle; each
+	// colour is solved as one batch, split between threads kept from step to step.
+	// Particles push rigid bodies and are pushed by them in proportion to their masses.
+	// Vertices and surface normals are kept in global coordinates, and the TriangleTree
+	// over them is refitted rather than rebuilt.
+	class DeformableBody : Body
+	{
+		public:
+
+		DeformableBody() = delete;
+		DeformableBody(const DeformableBody&) = delete;
+
+		// The pools give the rest shape, placed by the matrix.  mass is spread evenly over
+		// the vertices.  compliance is the inverse stiffness of the edges, 0 for ones that
+		// don't stretch.  Particles keep thickness away from rigid bodies.  Throws
+		// std::runtime_error if the edges can't be coloured with 64 colours, which takes a
+		// vertex with more than about 32 edges.
+		DeformableBody(const ModelViewMatrix<float>& modelViewMatrix, const Body::Pool&,
+			const RigidBody::Pool&, float mass, float compliance, float thickness);
+
+		~DeformableBody();
+
+		DeformableBody& operator=(const DeformableBody&) = delete;
+
+		// Keep a vertex where it is, e.g. the corners of a curtain.
+		void pin(unsigned vertex);
+
+		// Uniform acceleration of all vertices that aren't pinned, e.g. gravity.
+		ThreeVector<float>& getAcceleration() { return this->acceleration; }
+
+		// in global coordinates
+		const ThreeVector<float>* getVertices() const { return this->vertices; }
+
+		const ThreeVector<float>* getSurfaceNormals() const { return this->surfaceNormals; }
+
+		unsigned getVertexCount() const { return this->vertexCount; }
+
+		using Body::getFaces;
+		using Body::getTriangleCount;
+
+		const AxisAlignedBox& getBounds() const { return this->tree.getBounds(); }
+
+		CollisionFilter& getCollisionFilter() { return this->collisionFilter; }
+
+		private:
+
+		friend class RigidBody;
+		friend class SceneQuery;
+
+		// Allocate and fill the global geometry of a newly constructed body; returns its
+		// vertices.
+		static const ThreeVector<float>* transform(DeformableBody&,
+			const ModelViewMatrix<float>&, const RigidBody::Pool&);
+
+		// Advance all deformable bodies by timeInterval.
+		static void advanceState(float timeInterval);
+
+		void advance(float timeInterval);
+
+		// Solve the constraints from begin to end, which share no particles, four at a time
+		// where SSE2 is available.
+		void project(unsigned begin, unsigned end, float timeInterval);
+
+		// Push particles out of rigid bodies and the bodies back.
+		void collide(float timeInterval);
+
+		// Like nut::getPenetration, for rigid bodies of any shape.  Points are taken to be
+		// inside a mesh if they're behind its closest triangle.
+		static bool getPenetration(const RigidBody&, const ThreeVector<float>& point,
+			float distance, ThreeVector<float>& normal, float& depth);
+
+		const unsigned vertexCount;
+		const float compliance;
+		const float thickness;
+
+		ThreeVector<float> acceleration{.0f, .0f, .0f};
+
+		// particles, by coordinate
+		std::vector<float> position[3];
+		std::vector<float> previousPosition[3]; // at the beginning of the substep
+		std::vector<float> velocity[3];
+		std::vector<float> inverseMass; // 0 for pinned ones
+
+		// distance constraints, sorted by colour
+		std::vector<unsigned> constrained[2]; // particles
+		std::vector<float> restLength;
+		std::vector<float> lambda; // accumulated over a substep
+		std::vector<unsigned> batches; // beginning of each colour, and the end
+
+		TriangleTree tree;
+
+		CollisionFilter collisionFilter;
+
+		static std::vector<DeformableBody*> deformableBodies;
+	};
+
+	// Iterations of the constraint solver of DeformableBody per substep.
+	extern unsigned short solverIterations;
+
+	// Threads the constraint solver uses at most, 0 for one per hardware thread.  Small
+	// bodies use fewer.
+	extern unsigned solverThreadCount;
+}
+
+#endif //DEFORMABLEBODY_HPP_SEEN
 
 // vim: tw=90 ts=2 sts=-1 sw=0 noet
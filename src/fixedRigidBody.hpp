@@ -0,0 +1,269 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FIXEDRIGIDBODY_HPP_SEEN
+#define FIXEDRIGIDBODY_HPP_SEEN
+
+#include <array>
+#include <stdexcept>
+#include <tuple>
+
+#include "axisAlignedBox.hpp"
+#include "body.hpp"
+#include "threeVector.hpp" // needs to precede modelViewMatrix.hpp
+#include "modelViewMatrix.hpp"
+#include "rigidBody.hpp"
+#include "shape.hpp"
+
+namespace nut
+{
+	// Global coordinates of the vertices and surface normals of a FixedRigidBody.  A base
+	// class rather than members so they exist before RigidBody is constructed.
+	template <unsigned vertexCount, unsigned triangleCount>
+	struct FixedGeometry
+	{
+		ThreeVector<float> vertices[vertexCount];
+		ThreeVector<float> surfaceNormals[triangleCount];
+	};
+
+	// A mesh whose pools have vertexCount vertices and triangleCount triangles, e.g. a
+	// tetrahedron.  The sizes are template parameters, so transforming the body and testing
+	// its triangles take loops of constant length the compiler unrolls, and the geometry is
+	// kept inline rather than in the GeometryArena.  Mixes with all other rigid bodies.
+	// Against one of the same size, each vertex is tested against the plane of each of the
+	// other's triangles once, rather than once per pair of triangles, and only the pairs
+	// that straddle each other's planes are handed to Body::doesCollide.  Either way the
+	// result is the one of the loops over the pools.
+	template <unsigned vertexCount, unsigned triangleCount>
+	class FixedRigidBody : FixedGeometry<vertexCount, triangleCount>, public RigidBody
+	{
+		public:
+
+		FixedRigidBody() = delete;
+		FixedRigidBody(const FixedRigidBody&) = delete;
+
+		// Throws std::runtime_error if the pools are of a different size.
+		FixedRigidBody(float mass, const float(& momentOfInertia)[3],
+			const ModelViewMatrix<float>& modelViewMatrix,
+			const ThreeVector<float>& velocity,
+			float angularFrequency, const ThreeVector<float>& rotationAxis,
+			const Body::Pool&, const RigidBody::Pool&);
+
+		FixedRigidBody& operator=(const FixedRigidBody&) = delete;
+
+		private:
+
+		typedef FixedGeometry<vertexCount, triangleCount> Geometry;
+
+		typedef std::array<ThreeVector<float>, 2>* PartialCollisionContext;
+
+		static const Body::Pool& check(const Body::Pool&, const RigidBody::Pool&);
+
+		static void transformGeometry(RigidBody&);
+
+		static PartialCollisionContext doesCollideWithMesh(const RigidBody&,
+			const RigidBody&);
+
+		static PartialCollisionContext doesCollideWithShape(const RigidBody&, const Shape&,
+			const ModelViewMatrix<float>&);
+
+		// Whether the vertices of the face, at the given distances from the plane of another
+		// triangle, are all on one side of it; Body::doesCollide's first test.
+		static bool isSeparated(const float (& distances)[vertexCount],
+			const unsigned (& face)[3]);
+
+		// triangle of this size of body against one of the other body
+		static PartialCollisionContext doesCollideTriangles(const FixedRigidBody&,
+			unsigned i, const RigidBody& otherBody, unsigned j);
+
+		static const RigidBody::Kernels fixedKernels;
+	};
+
+	template <unsigned vertexCount, unsigned triangleCount>
+	const RigidBody::Kernels FixedRigidBody<vertexCount, triangleCount>::fixedKernels{
+		&FixedRigidBody::transformGeometry, &FixedRigidBody::doesCollideWithMesh,
+		&FixedRigidBody::doesCollideWithShape};
+
+	template <unsigned vertexCount, unsigned triangleCount>
+	FixedRigidBody<vertexCount, triangleCount>::FixedRigidBody(float mass,
+		const float(& momentOfInertia)[3], const ModelViewMatrix<float>& modelViewMatrix,
+		const ThreeVector<float>& velocity, float angularFrequency,
+		const ThreeVector<float>& rotationAxis, const Body::Pool& bodyPool,
+		const RigidBody::Pool& rigidBodyPool) :
+			RigidBody{mass, momentOfInertia, modelViewMatrix, velocity, angularFrequency,
+				rotationAxis, FixedRigidBody::check(bodyPool, rigidBodyPool), rigidBodyPool,
+				this->Geometry::vertices, this->Geometry::surfaceNormals,
+				FixedRigidBody::fixedKernels} {}
+
+	template <unsigned vertexCount, unsigned triangleCount>
+	const Body::Pool& FixedRigidBody<vertexCount, triangleCount>::check(
+		const Body::Pool& bodyPool, const RigidBody::Pool& rigidBodyPool)
+	{
+		if (std::get<1>(bodyPool) != triangleCount ||
+			std::get<2>(rigidBodyPool) != vertexCount)
+			throw std::runtime_error{"FixedRigidBody: pools of the wrong size"};
+
+		return bodyPool;
+	}
+
+	template <unsigned vertexCount, unsigned triangleCount>
+	void FixedRigidBody<vertexCount, triangleCount>::transformGeometry(RigidBody& body)
+	{
+		auto& geometry = static_cast<FixedRigidBody&>(body);
+		const ModelViewMatrix<float>& matrix = body.getObjectMatrix();
+
+		for (unsigned i = 0; i != vertexCount; ++i)
+		{
+			geometry.Geometry::vertices[i] = matrix *
+				static_cast<ThreeVector<float, VERTEX>&>(body.getVertex()[i]); // downcast
+		}
+
+		for (unsigned i = 0; i != triangleCount; ++i)
+		{
+			geometry.Geometry::surfaceNormals[i] = matrix *
+				static_cast<ThreeVector<float, NORMAL>&>(body.getSurfaceNormal()[i]);
+		}
+	}
+
+	template <unsigned vertexCount, unsigned triangleCount>
+	inline typename FixedRigidBody<vertexCount, triangleCount>::PartialCollisionContext
+	FixedRigidBody<vertexCount, triangleCount>::doesCollideTriangles(
+		const FixedRigidBody& body, unsigned i, const RigidBody& otherBody, unsigned j)
+	{
+		const auto& vertices = body.Geometry::vertices;
+		const unsigned (& face)[3] = body.getFaces()[i];
+		const unsigned (& otherFace)[3] = otherBody.getFaces()[j];
+
+		const ThreeVector<float>* const faces[2][3] = {
+			{&vertices[face[0]], &vertices[face[1]], &vertices[face[2]]},
+			{&otherBody.vertices[otherFace[0]], &otherBody.vertices[otherFace[1]],
+				&otherBody.vertices[otherFace[2]]}};
+
+		const ThreeVector<float>* const surfaceNormals[2] = {
+			&body.Geometry::surfaceNormals[i],
+			&otherBody.surfaceNormals[j]};
+
+		return RigidBody::doesCollide(faces, surfaceNormals);
+	}
+
+	template <unsigned vertexCount, unsigned triangleCount>
+	inline bool FixedRigidBody<vertexCount, triangleCount>::isSeparated(
+		const float (& distances)[vertexCount], const unsigned (& face)[3])
+	{
+		return (distances[face[0]] < .0f) == (distances[face[1]] < .0f) &&
+			(distances[face[0]] < .0f) == (distances[face[2]] < .0f);
+	}
+
+	template <unsigned vertexCount, unsigned triangleCount>
+	typename FixedRigidBody<vertexCount, triangleCount>::PartialCollisionContext
+	FixedRigidBody<vertexCount, triangleCount>::doesCollideWithMesh(const RigidBody& body,
+		const RigidBody& otherBody)
+	{
+		const auto& fixedBody = static_cast<const FixedRigidBody&>(body);
+
+		// Same order as Body::doesCollide; we take the first hit.
+		if (otherBody.kernels != &FixedRigidBody::fixedKernels)
+		{
+			for (unsigned i = 0; i != triangleCount; ++i)
+			{
+				for (unsigned j = 0; j != otherBody.getTriangleCount(); ++j)
+				{
+					if (auto partialCollisionContext =
+						FixedRigidBody::doesCollideTriangles(fixedBody, i, otherBody, j))
+					{
+						return partialCollisionContext;
+					}
+				}
+			}
+			return nullptr;
+		}
+
+		// Both are of this size.  The distances are computed as in Body::doesCollide, so
+		// the pairs skipped are the ones it would reject.
+		const auto& otherFixedBody = static_cast<const FixedRigidBody&>(otherBody);
+		const FixedRigidBody* const bodies[2] = {&fixedBody, &otherFixedBody};
+		float distances[2][triangleCount][vertexCount];
+
+		for (unsigned b = 0; b != 2; ++b)
+		{
+			const auto& vertices = bodies[b]->Geometry::vertices;
+			const auto& other = *bodies[1 - b];
+
+			for (unsigned j = 0; j != triangleCount; ++j)
+			{
+				const unsigned (& face)[3] = other.getFaces()[j];
+				const ThreeVector<float>& corner = other.Geometry::vertices[face[0]];
+				const ThreeVector<float>& surfaceNormal =
+					other.Geometry::surfaceNormals[j];
+
+				for (unsigned k = 0; k != vertexCount; ++k)
+					distances[b][j][k] = (corner - vertices[k]) * surfaceNormal;
+			}
+		}
+
+		for (unsigned i = 0; i != triangleCount; ++i)
+		{
+			for (unsigned j = 0; j != triangleCount; ++j)
+			{
+				if (FixedRigidBody::isSeparated(distances[0][j], body.getFaces()[i]) ||
+					FixedRigidBody::isSeparated(distances[1][i], otherBody.getFaces()[j]))
+				{
+					continue;
+				}
+
+				if (auto partialCollisionContext =
+					FixedRigidBody::doesCollideTriangles(fixedBody, i, otherBody, j))
+				{
+					return partialCollisionContext;
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	template <unsigned vertexCount, unsigned triangleCount>
+	typename FixedRigidBody<vertexCount, triangleCount>::PartialCollisionContext
+	FixedRigidBody<vertexCount, triangleCount>::doesCollideWithShape(const RigidBody& body,
+		const Shape& shape, const ModelViewMatrix<float>& matrix)
+	{
+		const auto& vertices = static_cast<const FixedRigidBody&>(body).Geometry::vertices;
+		AxisAlignedBox bounds = getBounds(shape, matrix);
+
+		for (unsigned i = 0; i != triangleCount; ++i)
+		{
+			const unsigned (& face)[3] = body.getFaces()[i];
+			const ThreeVector<float>* const corners[3] = {
+				&vertices[face[0]], &vertices[face[1]], &vertices[face[2]]};
+
+			AxisAlignedBox box = getEmptyBox();
+			grow(box, *corners[0]);
+			grow(box, *corners[1]);
+			grow(box, *corners[2]);
+
+			if (!doOverlap(box, bounds))
+				continue;
+
+			// We take the first hit.
+			if (auto partialCollisionContext = nut::doesCollide(shape, matrix, corners))
+				return partialCollisionContext;
+		}
+		return nullptr;
+	}
+}
+
+#endif //FIXEDRIGIDBODY_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,142 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "geometryArena.hpp"
+
+namespace nut
+{
+	std::vector<GeometryArena::Slab> GeometryArena::slabs;
+
+	ThreeVector<float>* GeometryArena::block = nullptr;
+	std::size_t GeometryArena::size = 0u;
+	std::size_t GeometryArena::capacity = 0u;
+	std::size_t GeometryArena::holeSize = 0u;
+
+	// Point every body to its geometry in newBlock, which replaces the current block.
+	void GeometryArena::relocate(ThreeVector<float>* newBlock)
+	{
+		GeometryArena::block = newBlock;
+
+		for (const auto& slab : GeometryArena::slabs)
+		{
+			if (slab.body)
+			{
+				slab.body->vertices = newBlock + slab.offset;
+				slab.body->surfaceNormals = newBlock + slab.offset + slab.vertexCount;
+			}
+		}
+	}
+
+	void GeometryArena::allocate(Body& body, std::size_t vertexCount,
+		std::size_t normalCount)
+	{
+		if (GeometryArena::size + vertexCount + normalCount > GeometryArena::capacity)
+		{
+			std::size_t newCapacity = std::max(2u * GeometryArena::capacity,
+				GeometryArena::size + vertexCount + normalCount);
+
+			// ThreeVector<float> is trivially copyable, so realloc may move it.
+			auto newBlock = static_cast<ThreeVector<float>*>(std::realloc(
+				GeometryArena::block, newCapacity * sizeof(ThreeVector<float>)));
+			if (!newBlock)
+				throw std::bad_alloc{};
+
+			GeometryArena::capacity = newCapacity;
+			GeometryArena::relocate(newBlock);
+		}
+
+		GeometryArena::slabs.push_back(Slab{&body, GeometryArena::size, vertexCount,
+			normalCount});
+		GeometryArena::size += vertexCount + normalCount;
+
+		body.vertices = GeometryArena::block + GeometryArena::slabs.back().offset;
+		body.surfaceNormals = body.vertices + vertexCount;
+	}
+
+	void GeometryArena::release(Body& body)
+	{
+		// Slabs are sorted by offset, and so are the bodies' vertices.
+		auto slab = std::lower_bound(GeometryArena::slabs.begin(),
+			GeometryArena::slabs.end(),
+			static_cast<std::size_t>(body.vertices - GeometryArena::block),
+			[](const Slab& slab, std::size_t offset) { return slab.offset < offset; });
+
+		// Slabs without vertices share their offset with the following one.
+		while (slab != GeometryArena::slabs.end() && slab->body != &body)
+			++slab;
+
+		assert(slab != GeometryArena::slabs.end());
+
+		slab->body = nullptr;
+		GeometryArena::holeSize += slab->vertexCount + slab->normalCount;
+
+		if (2u * GeometryArena::holeSize < GeometryArena::size)
+			return;
+
+		// Slide the remaining geometry together and drop the holes.
+		std::size_t offset = 0u;
+		auto end = GeometryArena::slabs.begin();
+
+		for (auto& slab : GeometryArena::slabs)
+		{
+			if (!slab.body)
+				continue;
+
+			// Bodies without geometry may be left when there's no block at all.
+			if (slab.vertexCount + slab.normalCount != 0u)
+			{
+				std::memmove(GeometryArena::block + offset, GeometryArena::block + slab.offset,
+					(slab.vertexCount + slab.normalCount) * sizeof(ThreeVector<float>));
+			}
+			slab.offset = offset;
+			offset += slab.vertexCount + slab.normalCount;
+			*end++ = slab;
+		}
+
+		GeometryArena::slabs.erase(end, GeometryArena::slabs.end());
+		GeometryArena::size = offset;
+		GeometryArena::holeSize = 0u;
+
+		// Give back memory that is unlikely to be needed again soon.
+		ThreeVector<float>* newBlock = GeometryArena::block;
+
+		if (GeometryArena::size == 0u)
+		{
+			std::free(GeometryArena::block);
+			newBlock = nullptr;
+			GeometryArena::capacity = 0u;
+		}
+		else if (4u * GeometryArena::size < GeometryArena::capacity)
+		{
+			if (auto shrunkBlock = static_cast<ThreeVector<float>*>(std::realloc(
+				GeometryArena::block, 2u * GeometryArena::size * sizeof(ThreeVector<float>))))
+			{
+				newBlock = shrunkBlock;
+				GeometryArena::capacity = 2u * GeometryArena::size;
+			}
+		}
+
+		GeometryArena::relocate(newBlock);
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
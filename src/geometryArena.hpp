@@ -0,0 +1,70 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GEOMETRYARENA_HPP_SEEN
+#define GEOMETRYARENA_HPP_SEEN
+
+#include <cstddef> // std::size_t
+#include <vector>
+
+#include "body.hpp"
+#include "threeVector.hpp"
+
+namespace nut
+{
+	// Keeps the global coordinates of the vertices and surface normals of all bodies in a
+	// single block of memory, in the order the bodies were created.  Each body's vertices
+	// are directly followed by its surface normals.
+	//
+	// Releasing a body's geometry leaves a hole.  Once holes make up half of the block, the
+	// remaining geometry is slid together (keeping its order) and the block shrunk.  Growing
+	// and compacting the block moves geometry around; the vertices and surfaceNormals
+	// pointers of the affected bodies are updated whenever that happens.
+	class GeometryArena
+	{
+		public:
+
+		GeometryArena() = delete;
+
+		// Set the body's vertices and surfaceNormals pointers to fresh, uninitialized space.
+		static void allocate(Body&, std::size_t vertexCount, std::size_t normalCount);
+
+		static void release(Body&);
+
+		private:
+
+		struct Slab
+		{
+			Body* body; // nullptr for holes
+			std::size_t offset;
+			std::size_t vertexCount;
+			std::size_t normalCount;
+		};
+
+		static void relocate(ThreeVector<float>* newBlock);
+
+		static std::vector<Slab> slabs; // sorted by offset
+
+		static ThreeVector<float>* block;
+		static std::size_t size; // used (including holes) and allocated number of vectors
+		static std::size_t capacity;
+		static std::size_t holeSize;
+	};
+}
+
+#endif //GEOMETRYARENA_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
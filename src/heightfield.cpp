@@ -0,0 +1,68 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include "heightfield.hpp"
+#include "rigidBody.hpp"
+
+namespace nut
+{
+	std::vector<Heightfield*> Heightfield::heightfields;
+
+	Heightfield::Heightfield(const float heights[], unsigned columnCount,
+		unsigned rowCount, float spacing, const ThreeVector<float>& origin) :
+			heights(columnCount * rowCount), columnCount{columnCount}, rowCount{rowCount},
+			spacing{spacing}, origin{origin[0], origin[2]}
+	{
+		assert(columnCount >= 2u && rowCount >= 2u);
+
+		auto range = std::minmax_element(heights, heights + columnCount * rowCount);
+
+		const float levels = std::numeric_limits<std::uint16_t>::max();
+
+		this->baseHeight = origin[1] + *range.first;
+		this->heightStep = (*range.second - *range.first) / levels;
+		if (this->heightStep == .0f)
+			this->heightStep = 1.f; // Flat; any step will do.
+
+		for (unsigned i = 0u; i != columnCount * rowCount; ++i)
+		{
+			this->heights[i] = static_cast<std::uint16_t>(
+				std::lround((heights[i] - *range.first) / this->heightStep));
+		}
+
+		this->bounds = AxisAlignedBox{
+			{origin[0], origin[1] + *range.first, origin[2]},
+			{origin[0] + (columnCount - 1u) * spacing, origin[1] + *range.second,
+			 origin[2] + (rowCount - 1u) * spacing}};
+
+		Heightfield::heightfields.push_back(this);
+	}
+
+	Heightfield::~Heightfield()
+	{
+		Heightfield::heightfields.erase(std::find(Heightfield::heightfields.begin(),
+			Heightfield::heightfields.end(), this));
+
+		RigidBody::forgetContacts(this);
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
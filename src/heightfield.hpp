@@ -0,0 +1,164 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HEIGHTFIELD_HPP_SEEN
+#define HEIGHTFIELD_HPP_SEEN
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "axisAlignedBox.hpp"
+#include "contact.hpp"
+#include "threeVector.hpp"
+
+namespace nut
+{
+	// Terrain that doesn't move, given by heights (along the y axis) over a regular grid in
+	// the x-z plane.  Each cell of the grid is split into two triangles.  Heights are
+	// quantized to 16 bits between the lowest and the highest of them.
+	//
+	// Rigid bodies are tested against the triangles of those cells only that lie under
+	// their own triangles; finding a cell takes constant time.
+	class Heightfield
+	{
+		public:
+
+		Heightfield() = delete;
+		Heightfield(const Heightfield&) = delete;
+
+		// heights holds columnCount * rowCount values, row by row.  The grid point in column
+		// i and row j is at x = origin[0] + i * spacing and z = origin[2] + j * spacing and
+		// origin[1] is added to its height.  There have to be at least two rows and columns.
+		Heightfield(const float heights[], unsigned columnCount, unsigned rowCount,
+			float spacing, const ThreeVector<float>& origin);
+
+		~Heightfield();
+
+		Heightfield& operator=(const Heightfield&) = delete;
+
+		float getHeight(unsigned column, unsigned row) const {
+			return this->baseHeight +
+				this->heightStep * this->heights[row * this->columnCount + column];
+		}
+
+		unsigned getColumnCount() const { return this->columnCount; }
+
+		unsigned getRowCount() const { return this->rowCount; }
+
+		const AxisAlignedBox& getBounds() const { return this->bounds; }
+
+		CollisionFilter& getCollisionFilter() { return this->collisionFilter; }
+
+		private:
+
+		friend class RigidBody;
+		friend class SceneQuery;
+
+		// Call visit(corners, surfaceNormal) for both triangles of each cell that might
+		// intersect the box, until a call returns true.  Returns whether one did.  corners
+		// is an array of three ThreeVector<float>s in counterclockwise order seen from
+		// above; the surface normal points up.
+		template <typename Visitor>
+		bool visitTriangles(const AxisAlignedBox&, Visitor visit) const;
+
+		std::vector<std::uint16_t> heights;
+		unsigned columnCount;
+		unsigned rowCount;
+		float spacing;
+		float origin[2]; // x and z
+		float baseHeight; // of a quantized height of 0
+		float heightStep;
+		AxisAlignedBox bounds;
+		CollisionFilter collisionFilter;
+
+		static std::vector<Heightfield*> heightfields;
+	};
+
+	template <typename Visitor>
+	bool Heightfield::visitTriangles(const AxisAlignedBox& box, Visitor visit) const
+	{
+		// Cells covered by the box.  The ranges are clamped to the grid and may be empty.
+		float first[2] = {
+			std::floor((box.min[0] - this->origin[0]) / this->spacing),
+			std::floor((box.min[2] - this->origin[1]) / this->spacing)};
+		float last[2] = {
+			std::floor((box.max[0] - this->origin[0]) / this->spacing),
+			std::floor((box.max[2] - this->origin[1]) / this->spacing)};
+
+		// Written so NaNs fail too.  The ranges are clamped as floats, as converting those
+		// out of the range of unsigned is undefined.
+		if (!(last[0] >= 0.f && last[1] >= 0.f && first[0] < this->columnCount - 1u &&
+			first[1] < this->rowCount - 1u))
+		{
+			return false;
+		}
+
+		unsigned columnBegin = static_cast<unsigned>(std::max(first[0], 0.f));
+		unsigned rowBegin = static_cast<unsigned>(std::max(first[1], 0.f));
+		unsigned columnEnd = static_cast<unsigned>(std::min(last[0],
+			static_cast<float>(this->columnCount - 2u))) + 1u;
+		unsigned rowEnd = static_cast<unsigned>(std::min(last[1],
+			static_cast<float>(this->rowCount - 2u))) + 1u;
+
+		// Quantized bound below which a cell can't reach into the box.
+		float lowestHeight = (box.min[1] - this->baseHeight) / this->heightStep;
+
+		for (unsigned row = rowBegin; row != rowEnd; ++row)
+		{
+			for (unsigned column = columnBegin; column != columnEnd; ++column)
+			{
+				const std::uint16_t* height = &this->heights[row * this->columnCount + column];
+
+				if (std::max(std::max(height[0], height[1]),
+					std::max(height[this->columnCount], height[this->columnCount + 1u])) <
+					lowestHeight)
+				{
+					continue;
+				}
+
+				float x[2] = {this->origin[0] + column * this->spacing};
+				float z[2] = {this->origin[1] + row * this->spacing};
+				x[1] = x[0] + this->spacing;
+				z[1] = z[0] + this->spacing;
+
+				float y[2][2] = {
+					{this->getHeight(column, row), this->getHeight(column, row + 1u)},
+					{this->getHeight(column + 1u, row), this->getHeight(column + 1u, row + 1u)}};
+
+				const ThreeVector<float> triangles[2][3] = {
+					{{x[0], y[0][0], z[0]}, {x[0], y[0][1], z[1]}, {x[1], y[1][1], z[1]}},
+					{{x[0], y[0][0], z[0]}, {x[1], y[1][1], z[1]}, {x[1], y[1][0], z[0]}}};
+
+				for (const auto& triangle : triangles)
+				{
+					const ThreeVector<float> surfaceNormal(getCrossProduct(
+						triangle[1] - triangle[0], triangle[2] - triangle[0]).getUnitVector());
+
+					if (visit(triangle, surfaceNormal))
+						return true;
+				}
+			}
+		}
+
+		return false;
+	}
+}
+
+#endif //HEIGHTFIELD_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
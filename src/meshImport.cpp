@@ -0,0 +1,358 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "meshImport.hpp"
+#include "parallel.hpp"
+
+namespace nut
+{
+	std::size_t importChunkSize = 1u << 24;
+
+	namespace
+	{
+		// Hands out one index per distinct triple of coordinates.
+		class Welder
+		{
+			public:
+
+			Welder(std::vector<ThreeVector<float>>& vertices) : vertices(vertices) {}
+
+			unsigned weld(float x, float y, float z)
+			{
+				// Adding zero turns -0 into +0, which would otherwise hash differently.
+				Key key{};
+				x += .0f; y += .0f; z += .0f;
+				std::memcpy(&key.bits[0], &x, sizeof x);
+				std::memcpy(&key.bits[1], &y, sizeof y);
+				std::memcpy(&key.bits[2], &z, sizeof z);
+
+				auto inserted = this->indices.emplace(key,
+					static_cast<unsigned>(this->vertices.size()));
+				if (inserted.second)
+					this->vertices.emplace_back(x, y, z);
+
+				return inserted.first->second;
+			}
+
+			private:
+
+			struct Key
+			{
+				std::uint32_t bits[3];
+
+				bool operator==(const Key& other) const {
+					return std::equal(this->bits, this->bits + 3, other.bits);
+				}
+			};
+
+			struct Hash
+			{
+				std::size_t operator()(const Key& key) const {
+					return (key.bits[0] * 73856093u) ^ (key.bits[1] * 19349663u) ^
+						(key.bits[2] * 83492791u);
+				}
+			};
+
+			std::unordered_map<Key, unsigned, Hash> indices;
+			std::vector<ThreeVector<float>>& vertices;
+		};
+
+		void addTriangle(std::vector<unsigned>& faces, unsigned a, unsigned b, unsigned c)
+		{
+			if (a != b && b != c && c != a)
+				faces.insert(faces.end(), {a, b, c});
+		}
+
+		// Split [begin, end) into count slices that end right after a newline.  The last
+		// character of the range has to be a newline.
+		std::vector<const char*> split(const char* begin, const char* end, unsigned count)
+		{
+			std::vector<const char*> bounds{begin};
+			for (unsigned i = 1u; i < count; ++i)
+			{
+				const char* bound = std::max(bounds.back(),
+					begin + (end - begin) * static_cast<std::ptrdiff_t>(i) / count);
+				bounds.push_back(std::find(bound, end, '\n') + (bound != end));
+				bounds.back() = std::min(bounds.back(), end);
+			}
+			bounds.push_back(end);
+			return bounds;
+		}
+
+		// A vertex index of an OBJ face.  Relative ones are counted from the first vertex of
+		// the slice the face was parsed from and may be negative.
+		struct ObjIndex
+		{
+			long vertex;
+			bool isRelative;
+		};
+
+		// What one thread makes of one slice of an OBJ file.
+		struct ObjSlice
+		{
+			std::vector<float> coordinates; // three per vertex
+			std::vector<ObjIndex> indices;
+			std::vector<unsigned> polygonSizes;
+			std::string error;
+		};
+
+		void skipBlanks(const char*& position)
+		{
+			while (*position == ' ' || *position == '\t')
+				++position;
+		}
+
+		bool isEndOfToken(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+		}
+
+		// Parse the vertices and faces of the lines in [position, end).  Everything else is
+		// ignored.
+		void parseObj(const char* position, const char* end, ObjSlice& slice)
+		{
+			for (; position < end; position = std::find(position, end, '\n') + 1)
+			{
+				skipBlanks(position);
+
+				if (position[0] == 'v' && (position[1] == ' ' || position[1] == '\t'))
+				{
+					++position;
+					for (int i = 0; i != 3; ++i)
+					{
+						skipBlanks(position);
+						char* numberEnd;
+						float coordinate = std::strtof(position, &numberEnd);
+						if (numberEnd == position || !isEndOfToken(*numberEnd))
+						{
+							slice.error = "malformed vertex";
+							return;
+						}
+						slice.coordinates.push_back(coordinate);
+						position = numberEnd;
+					}
+				}
+				else if (position[0] == 'f' && (position[1] == ' ' || position[1] == '\t'))
+				{
+					++position;
+					unsigned polygonSize = 0u;
+					for (skipBlanks(position); !isEndOfToken(*position); skipBlanks(position))
+					{
+						char* numberEnd;
+						long index = std::strtol(position, &numberEnd, 10);
+						if (numberEnd == position || index == 0)
+						{
+							slice.error = "malformed face";
+							return;
+						}
+						// Negative indices count back from the latest vertex.
+						if (index < 0)
+							slice.indices.push_back(ObjIndex{
+								static_cast<long>(slice.coordinates.size() / 3u) + index, true});
+						else
+							slice.indices.push_back(ObjIndex{index - 1, false});
+						++polygonSize;
+						position = numberEnd;
+						while (!isEndOfToken(*position)) // Skip "/texture/normal" indices.
+							++position;
+					}
+					slice.polygonSizes.push_back(polygonSize);
+				}
+			}
+		}
+
+		bool isStl(const char* fileName)
+		{
+			std::string name{fileName};
+			if (name.size() < 4u)
+				return false;
+			std::transform(name.end() - 4, name.end(), name.end() - 4,
+				[](char c) { return std::tolower(static_cast<unsigned char>(c)); });
+			return name.compare(name.size() - 4u, 4u, ".stl") == 0;
+		}
+	}
+
+	ImportedMesh::ImportedMesh(const char* fileName, unsigned threadCount) :
+		ImportedMesh{fileName, isStl(fileName) ? MeshFormat::STL : MeshFormat::OBJ,
+		             threadCount} {}
+
+	ImportedMesh::ImportedMesh(const char* fileName, MeshFormat format,
+		unsigned threadCount)
+	{
+		if (threadCount == 0u)
+			threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+		std::ifstream file{fileName, std::ios::binary};
+		if (!file)
+			throw std::runtime_error{std::string{"can't open "} + fileName};
+
+		Welder welder{this->vertices};
+
+		if (format == MeshFormat::OBJ)
+		{
+			// Maps the indices of the file's vertices to those of the welded vertices.
+			std::vector<unsigned> weldedIndex;
+			std::vector<char> chunk;
+			std::vector<ObjSlice> slices(threadCount);
+
+			while (file)
+			{
+				// Keep the incomplete last line of the previous chunk.
+				std::size_t carried = chunk.size();
+				chunk.resize(carried + importChunkSize);
+				file.read(chunk.data() + carried, static_cast<std::streamsize>(importChunkSize));
+				chunk.resize(carried + static_cast<std::size_t>(file.gcount()));
+
+				std::size_t length;
+				if (file)
+				{
+					length = static_cast<std::size_t>(
+						std::find(chunk.rbegin(), chunk.rend(), '\n').base() - chunk.begin());
+					if (length == 0u)
+						continue; // A single line longer than the chunk; read more of it.
+				}
+				else
+				{
+					chunk.push_back('\n');
+					length = chunk.size();
+				}
+				chunk.push_back('\0'); // Stops strtof and friends at the end of the chunk.
+
+				auto bounds = split(chunk.data(), chunk.data() + length, threadCount);
+				runInParallel(threadCount, [&](unsigned i) {
+					slices[i] = ObjSlice{};
+					parseObj(bounds[i], bounds[i + 1u], slices[i]);
+				});
+
+				for (const auto& slice : slices)
+				{
+					if (!slice.error.empty())
+						throw std::runtime_error{std::string{fileName} + ": " + slice.error};
+
+					long firstVertex = static_cast<long>(weldedIndex.size());
+
+					for (std::size_t i = 0; i < slice.coordinates.size(); i += 3u)
+						weldedIndex.push_back(welder.weld(slice.coordinates[i],
+							slice.coordinates[i + 1u], slice.coordinates[i + 2u]));
+
+					auto index = slice.indices.begin();
+					for (unsigned polygonSize : slice.polygonSizes)
+					{
+						unsigned polygon[3];
+						for (unsigned i = 0u; i != polygonSize; ++i, ++index)
+						{
+							long vertex = index->isRelative ? firstVertex + index->vertex :
+								index->vertex;
+							if (vertex < 0 || vertex >= static_cast<long>(weldedIndex.size()))
+								throw std::runtime_error{std::string{fileName} +
+									": face refers to an undefined vertex"};
+
+							polygon[std::min(i, 2u)] = weldedIndex[static_cast<std::size_t>(vertex)];
+							if (i >= 2u)
+							{
+								addTriangle(this->faces, polygon[0], polygon[1], polygon[2]);
+								polygon[1] = polygon[2];
+							}
+						}
+					}
+				}
+
+				chunk.erase(chunk.begin(), chunk.begin() + static_cast<std::ptrdiff_t>(
+					std::min(length, chunk.size() - 1u)));
+				chunk.pop_back(); // the null character
+			}
+		}
+		else
+		{
+			// An 80 byte header, the number of triangles and 50 bytes per triangle: a normal,
+			// three vertices and an attribute byte count.  All numbers are little-endian, like
+			// those of the machines this is meant to run on.
+			const std::size_t headerSize = 84u, triangleSize = 50u;
+
+			file.seekg(0, std::ios::end);
+			std::size_t fileSize = static_cast<std::size_t>(file.tellg());
+			file.seekg(80, std::ios::beg);
+
+			std::uint32_t triangleCount = 0u;
+			file.read(reinterpret_cast<char*>(&triangleCount), sizeof triangleCount);
+
+			if (!file || fileSize != headerSize + triangleSize * triangleCount)
+				throw std::runtime_error{std::string{fileName} + " is no binary STL file"};
+
+			std::size_t chunkTriangles = std::max<std::size_t>(importChunkSize / triangleSize,
+				threadCount);
+			std::vector<char> chunk(chunkTriangles * triangleSize);
+			std::vector<std::vector<float>> slices(threadCount); // nine floats per triangle
+
+			for (std::size_t first = 0u; first < triangleCount; first += chunkTriangles)
+			{
+				std::size_t count = std::min<std::size_t>(chunkTriangles,
+					triangleCount - first);
+				file.read(chunk.data(), static_cast<std::streamsize>(count * triangleSize));
+				if (!file)
+					throw std::runtime_error{std::string{"can't read "} + fileName};
+
+				runInParallel(threadCount, [&](unsigned i) {
+					std::size_t begin = count * i / threadCount;
+					std::size_t end = count * (i + 1u) / threadCount;
+					slices[i].resize(9u * (end - begin));
+					for (std::size_t j = begin; j != end; ++j)
+						std::memcpy(&slices[i][9u * (j - begin)],
+							chunk.data() + j * triangleSize + 3u * sizeof(float),
+							9u * sizeof(float));
+				});
+
+				for (const auto& slice : slices)
+				{
+					for (std::size_t i = 0; i < slice.size(); i += 9u)
+					{
+						addTriangle(this->faces,
+							welder.weld(slice[i], slice[i + 1u], slice[i + 2u]),
+							welder.weld(slice[i + 3u], slice[i + 4u], slice[i + 5u]),
+							welder.weld(slice[i + 6u], slice[i + 7u], slice[i + 8u]));
+					}
+				}
+			}
+		}
+
+		this->faces.shrink_to_fit();
+		this->vertices.shrink_to_fit();
+		this->surfaceNormals.resize(this->faces.size() / 3u);
+
+		this->bodyPool = Body::Pool{reinterpret_cast<unsigned(*)[3]>(this->faces.data()),
+			this->surfaceNormals.size()};
+		this->rigidBodyPool = RigidBody::Pool{this->vertices.data(),
+			this->surfaceNormals.data(), static_cast<unsigned>(this->vertices.size())};
+
+		computeSurfaceNormals(this->bodyPool, this->vertices.data(),
+			this->surfaceNormals.data());
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,79 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MESHIMPORT_HPP_SEEN
+#define MESHIMPORT_HPP_SEEN
+
+#include <cstddef> // std::size_t
+#include <vector>
+
+#include "body.hpp"
+#include "rigidBody.hpp"
+#include "threeVector.hpp"
+
+namespace nut
+{
+	enum class MeshFormat : unsigned char{OBJ, STL}; // STL means binary STL
+
+	// Geometry read from a mesh file.  Vertices with identical coordinates are welded into
+	// one, triangles that degenerate by that are dropped and polygons are split into fans of
+	// triangles.  Surface normals are computed from the (counterclockwise) winding of the
+	// triangles; normals stored in the file are ignored.
+	//
+	// The file is read in chunks of a fixed size that are parsed by several threads at once,
+	// so memory use beyond the resulting pools stays bounded for arbitrarily large files.
+	//
+	// Owns the arrays the pools point to and has to outlive all bodies constructed from it.
+	class ImportedMesh
+	{
+		public:
+
+		ImportedMesh() = delete;
+		ImportedMesh(const ImportedMesh&) = delete;
+
+		// Throws std::runtime_error if the file can't be read or parsed.  A threadCount of 0
+		// uses one thread per hardware thread.
+		ImportedMesh(const char* fileName, MeshFormat, unsigned threadCount = 0u);
+
+		// Picks the format from the extension of the file name: ".stl" (in any case) means
+		// binary STL, anything else OBJ.
+		explicit ImportedMesh(const char* fileName, unsigned threadCount = 0u);
+
+		~ImportedMesh() = default;
+
+		ImportedMesh& operator=(const ImportedMesh&) = delete;
+
+		const Body::Pool& getBodyPool() const { return this->bodyPool; }
+
+		const RigidBody::Pool& getRigidBodyPool() const { return this->rigidBodyPool; }
+
+		private:
+
+		std::vector<unsigned> faces; // three indices per triangle
+		std::vector<ThreeVector<float>> vertices;
+		std::vector<ThreeVector<float>> surfaceNormals;
+
+		Body::Pool bodyPool;
+		RigidBody::Pool rigidBodyPool;
+	};
+
+	// Bytes of a file held in memory at once (per chunk) by ImportedMesh.
+	extern std::size_t importChunkSize;
+}
+
+#endif //MESHIMPORT_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -16,6 +16,12 @@ namespace nut
 			entries[8], entries[9], entries[10], entries[11],
 			entries[12], entries[13], entries[14], entries[15]} {}
 
+	template <typename T>
+	ModelViewMatrix<T>::operator const T*() const
+	{
+		return this->entries;
+	}
+
 	template <typename T>
 	ModelViewMatrix<T>::operator T*()
 	{
@@ -0,0 +1,418 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "body.hpp"
+#include "fixedRigidBody.hpp"
+#include "narrowPhaseHarness.hpp"
+#include "rigidBody.hpp"
+#include "threeVector.hpp" // needs to precede modelViewMatrix.hpp
+#include "modelViewMatrix.hpp"
+#include "triangleTree.hpp"
+
+namespace nut
+{
+	namespace
+	{
+		// triangles of each mesh of a SOUP case
+		constexpr unsigned soupSize = 8u;
+
+		// cases NarrowPhaseHarness::time keeps at once
+		constexpr std::uint64_t timedBatchSize = 1024u;
+
+		unsigned faces[soupSize][3] = {{0u, 1u, 2u}, {3u, 4u, 5u}, {6u, 7u, 8u},
+			{9u, 10u, 11u}, {12u, 13u, 14u}, {15u, 16u, 17u}, {18u, 19u, 20u},
+			{21u, 22u, 23u}};
+
+		struct Kernel
+		{
+			const char* name;
+			bool isExact; // whether it tests the pairs of triangles in the reference's order
+		};
+
+		const Kernel kernels[] = {{"reference", true}, {"tree", false}, {"fixed", true},
+			{"fixed-generic", true}};
+
+		constexpr unsigned kernelCount = sizeof kernels / sizeof kernels[0];
+
+		const char* const caseTypeNames[] = {"RANDOM", "COPLANAR", "TOUCHING", "PARALLEL",
+			"SHARED", "GRID", "SOUP"};
+
+		constexpr unsigned caseTypeCount = sizeof caseTypeNames / sizeof caseTypeNames[0];
+
+		void set(ThreeVector<float>& vector, float x, float y, float z)
+		{
+			vector[0] = x;
+			vector[1] = y;
+			vector[2] = z;
+		}
+
+		bool isFinite(const std::array<ThreeVector<float>, 2>& partialCollisionContext)
+		{
+			for (const auto& vector : partialCollisionContext)
+			{
+				if (!std::isfinite(vector[0]) || !std::isfinite(vector[1]) ||
+					!std::isfinite(vector[2]))
+					return false;
+			}
+			return true;
+		}
+
+		// Bit for bit, so NaNs compare equal to themselves.
+		bool isSame(const std::array<ThreeVector<float>, 2>& first,
+			const std::array<ThreeVector<float>, 2>& second)
+		{
+			return !std::memcmp(static_cast<const float*>(first[0]),
+					static_cast<const float*>(second[0]), 3u * sizeof(float)) &&
+				!std::memcmp(static_cast<const float*>(first[1]),
+					static_cast<const float*>(second[1]), 3u * sizeof(float));
+		}
+	}
+
+	const char* getName(CaseType type)
+	{
+		return caseTypeNames[static_cast<unsigned>(type)];
+	}
+
+	// The pools of a case, in object coordinates, and where its meshes are placed.
+	struct NarrowPhaseHarness::Case
+	{
+		Case(std::uint64_t seed, std::uint64_t index);
+		Case(const Case&) = delete;
+
+		Case& operator=(const Case&) = delete;
+
+		CaseType type;
+		unsigned triangleCount;
+
+		std::vector<ThreeVector<float>> vertices[2];
+		std::vector<ThreeVector<float>> surfaceNormals[2];
+		ModelViewMatrix<float> matrices[2];
+
+		Body::Pool bodyPool;
+		RigidBody::Pool rigidBodyPools[2];
+	};
+
+	// Bodies of a case for the reference and each kernel.
+	struct NarrowPhaseHarness::Bodies
+	{
+		explicit Bodies(const Case&);
+		Bodies(const Bodies&) = delete;
+
+		Bodies& operator=(const Bodies&) = delete;
+
+		std::unique_ptr<RigidBody> generic[2];
+		std::unique_ptr<FixedRigidBody<3u, 1u>> triangles[2];
+		std::unique_ptr<FixedRigidBody<3u * soupSize, soupSize>> soups[2];
+		const RigidBody* fixed[2]; // whichever of triangles and soups there are
+
+		std::unique_ptr<TriangleTree> tree; // over the global vertices of generic[1]
+	};
+
+	NarrowPhaseHarness::Case::Case(std::uint64_t seed, std::uint64_t index) :
+		type{static_cast<CaseType>(index % caseTypeCount)},
+		triangleCount{this->type == CaseType::SOUP ? soupSize : 1u}
+	{
+		std::mt19937_64 random{seed ^ index * 0x9e3779b97f4a7c15u};
+		std::uniform_real_distribution<float> uniform{-1.f, 1.f};
+		std::uniform_int_distribution<int> grid{-2, 2};
+
+		for (auto& vertices : this->vertices)
+			vertices.resize(3u * this->triangleCount);
+
+		ThreeVector<float>* first = this->vertices[0].data();
+		ThreeVector<float>* second = this->vertices[1].data();
+
+		// Either is a triangle; its corners are set below.
+		for (unsigned i = 0u; i != 3u * this->triangleCount; ++i)
+		{
+			set(first[i], uniform(random), uniform(random), uniform(random));
+			set(second[i], uniform(random), uniform(random), uniform(random));
+		}
+
+		switch (this->type)
+		{
+			case CaseType::RANDOM:
+				break;
+
+			case CaseType::COPLANAR:
+				for (unsigned i = 0u; i != 3u; ++i)
+					first[i][2] = second[i][2] = .0f;
+				break;
+
+			case CaseType::TOUCHING:
+				for (unsigned i = 0u; i != 3u; ++i)
+					first[i][2] = .0f;
+				second[0][2] = .0f;
+				break;
+
+			case CaseType::PARALLEL:
+			{
+				float height = 1e-3f * uniform(random);
+				float slope = std::pow(10.f, -4.5f + 2.5f * uniform(random));
+
+				for (unsigned i = 0u; i != 3u; ++i)
+				{
+					first[i][2] = .0f;
+					second[i][2] = height + slope * second[i][0];
+				}
+				break;
+			}
+
+			case CaseType::SHARED:
+				second[0] = first[0];
+				if (random() & 1u)
+					second[1] = first[1];
+				break;
+
+			case CaseType::GRID:
+				for (unsigned i = 0u; i != 3u; ++i)
+				{
+					set(first[i], .5f * grid(random), .5f * grid(random), .5f * grid(random));
+					set(second[i], .5f * grid(random), .5f * grid(random), .5f * grid(random));
+				}
+				break;
+
+			case CaseType::SOUP:
+				// Small triangles around random centers.
+				for (auto vertices : {first, second})
+				{
+					for (unsigned i = 0u; i != 3u * soupSize; i += 3u)
+					{
+						ThreeVector<float> center(vertices[i]);
+						for (unsigned j = 0u; j != 3u; ++j)
+						{
+							set(vertices[i + j], center[0] + .25f * uniform(random),
+								center[1] + .25f * uniform(random), center[2] + .25f * uniform(random));
+						}
+					}
+				}
+				break;
+		}
+
+		// Place the meshes: both where they are, both by the same random matrix, or, for
+		// cases that are random anyway, each by its own.
+		std::uniform_real_distribution<float> angle{.0f, 6.2831853f};
+		unsigned placement = random() % 2u;
+
+		if (this->type == CaseType::RANDOM || this->type == CaseType::SOUP)
+			placement = 2u;
+
+		for (unsigned i = 0u; i != 2u; ++i)
+		{
+			if (placement == 0u)
+				break;
+
+			if (placement == 1u && i == 1u)
+			{
+				this->matrices[1] = this->matrices[0];
+				break;
+			}
+
+			ThreeVector<float> axis(uniform(random), uniform(random), uniform(random));
+			if (float norm = axis.getNorm())
+				axis /= norm;
+			else
+				set(axis, .0f, 1.f, .0f);
+
+			this->matrices[i].rotate(angle(random), axis);
+			for (unsigned j = 0u; j != 3u; ++j)
+				this->matrices[i][12u + j] = .5f * uniform(random);
+		}
+
+		this->bodyPool = Body::Pool{faces, this->triangleCount};
+
+		for (unsigned i = 0u; i != 2u; ++i)
+		{
+			this->surfaceNormals[i].resize(this->triangleCount);
+			computeSurfaceNormals(this->bodyPool, this->vertices[i].data(),
+				this->surfaceNormals[i].data());
+
+			this->rigidBodyPools[i] = RigidBody::Pool{this->vertices[i].data(),
+				this->surfaceNormals[i].data(), 3u * this->triangleCount};
+		}
+	}
+
+	NarrowPhaseHarness::Bodies::Bodies(const Case& testCase)
+	{
+		const float momentOfInertia[3] = {1.f, 1.f, 1.f};
+		const ThreeVector<float> still{.0f, .0f, .0f}, axis{.0f, 1.f, .0f};
+
+		for (unsigned i = 0u; i != 2u; ++i)
+		{
+			this->generic[i].reset(new RigidBody{1.f, momentOfInertia,
+				testCase.matrices[i], still, .0f, axis, testCase.bodyPool,
+				testCase.rigidBodyPools[i]});
+
+			if (testCase.type == CaseType::SOUP)
+			{
+				this->soups[i].reset(new FixedRigidBody<3u * soupSize, soupSize>{1.f,
+					momentOfInertia, testCase.matrices[i], still, .0f, axis, testCase.bodyPool,
+					testCase.rigidBodyPools[i]});
+				this->fixed[i] = this->soups[i].get();
+			}
+			else
+			{
+				this->triangles[i].reset(new FixedRigidBody<3u, 1u>{1.f, momentOfInertia,
+					testCase.matrices[i], still, .0f, axis, testCase.bodyPool,
+					testCase.rigidBodyPools[i]});
+				this->fixed[i] = this->triangles[i].get();
+			}
+		}
+
+		this->tree.reset(new TriangleTree{faces, testCase.triangleCount,
+			this->generic[1]->getVertices()});
+	}
+
+	std::array<ThreeVector<float>, 2>* NarrowPhaseHarness::collide(const Bodies& bodies,
+		unsigned kernel)
+	{
+		const RigidBody& first = *bodies.generic[0];
+		const RigidBody& second = *bodies.generic[1];
+
+		switch (kernel)
+		{
+			case 0u:
+				return first.doesCollide(second);
+
+			case 1u:
+				return first.doesCollide(second, *bodies.tree);
+
+			case 2u:
+				return bodies.fixed[0]->doesCollide(*bodies.fixed[1]);
+
+			default:
+				return bodies.fixed[0]->doesCollide(second);
+		}
+	}
+
+	std::vector<NarrowPhaseHarness::Mismatch>
+	NarrowPhaseHarness::fuzz(std::uint64_t begin, std::uint64_t end) const
+	{
+		std::vector<Mismatch> mismatches;
+
+		for (std::uint64_t i = begin; i != end; ++i)
+		{
+			Case testCase{this->seed, i};
+			Bodies bodies{testCase};
+
+			std::unique_ptr<std::array<ThreeVector<float>, 2>> reference{
+				NarrowPhaseHarness::collide(bodies, 0u)};
+
+			if (reference && !isFinite(*reference))
+				mismatches.push_back({i, testCase.type, kernels[0].name, "not finite"});
+
+			for (unsigned j = 1u; j != kernelCount; ++j)
+			{
+				std::unique_ptr<std::array<ThreeVector<float>, 2>> result{
+					NarrowPhaseHarness::collide(bodies, j)};
+
+				if (reference && !result)
+					mismatches.push_back({i, testCase.type, kernels[j].name, "missed"});
+				else if (!reference && result)
+					mismatches.push_back({i, testCase.type, kernels[j].name, "spurious"});
+				else if (result && kernels[j].isExact && !isSame(*reference, *result))
+					mismatches.push_back({i, testCase.type, kernels[j].name, "different"});
+			}
+		}
+
+		return mismatches;
+	}
+
+	std::vector<std::pair<const char*, double>> NarrowPhaseHarness::time(
+		std::uint64_t begin, std::uint64_t end, unsigned repetitions) const
+	{
+		std::vector<std::pair<const char*, double>> times;
+		for (const auto& kernel : kernels)
+			times.emplace_back(kernel.name, .0);
+
+		// Bodies unregister themselves by a linear search, so keep few at a time.
+		for (std::uint64_t i = begin; i < end; i += timedBatchSize)
+		{
+			std::vector<std::unique_ptr<Case>> cases;
+			std::vector<std::unique_ptr<Bodies>> bodies;
+
+			for (std::uint64_t j = i; j != std::min(i + timedBatchSize, end); ++j)
+			{
+				cases.emplace_back(new Case{this->seed, j});
+				bodies.emplace_back(new Bodies{*cases.back()});
+			}
+
+			for (unsigned j = 0u; j != kernelCount; ++j)
+			{
+				auto start = std::chrono::steady_clock::now();
+
+				for (unsigned k = 0u; k != repetitions; ++k)
+				{
+					for (const auto& caseBodies : bodies)
+						delete NarrowPhaseHarness::collide(*caseBodies, j);
+				}
+
+				times[j].second += std::chrono::duration<double>(
+					std::chrono::steady_clock::now() - start).count();
+			}
+		}
+
+		return times;
+	}
+
+	void NarrowPhaseHarness::describe(std::ostream& stream, std::uint64_t caseIndex) const
+	{
+		Case testCase{this->seed, caseIndex};
+		Bodies bodies{testCase};
+
+		auto precision = stream.precision(9);
+
+		stream << "seed " << this->seed << ", case " << caseIndex << ", " <<
+			getName(testCase.type) << '\n';
+
+		for (unsigned i = 0u; i != 2u; ++i)
+		{
+			stream << "mesh " << i << ":\n";
+
+			for (unsigned j = 0u; j != 3u * testCase.triangleCount; ++j)
+				stream << (j % 3u ? "  " : "- ") << bodies.generic[i]->getVertices()[j] << '\n';
+		}
+
+		for (unsigned i = 0u; i != kernelCount; ++i)
+		{
+			std::unique_ptr<std::array<ThreeVector<float>, 2>> result{
+				NarrowPhaseHarness::collide(bodies, i)};
+
+			stream << kernels[i].name << ": ";
+			if (result)
+				stream << "point " << (*result)[0] << ", normal " << (*result)[1] << '\n';
+			else
+				stream << "none\n";
+		}
+
+		stream.precision(precision);
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
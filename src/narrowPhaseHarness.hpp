@@ -0,0 +1,103 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NARROWPHASEHARNESS_HPP_SEEN
+#define NARROWPHASEHARNESS_HPP_SEEN
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <utility>
+#include <vector>
+
+#include "threeVector.hpp"
+
+namespace nut
+{
+	// Kinds of cases NarrowPhaseHarness generates.  All but SOUP are pairs of single
+	// triangles aimed at a degenerate case of Body::doesCollide.
+	enum class CaseType : unsigned char
+	{
+		RANDOM, // corners anywhere in a cube
+		COPLANAR, // both triangles in one plane
+		TOUCHING, // a corner of one exactly in the plane of the other
+		PARALLEL, // planes a tiny angle apart, so the line of intersection nearly vanishes
+		SHARED, // one or two corners in common
+		GRID, // corners on a coarse grid, so many distances are exactly 0
+		SOUP // two meshes of several small triangles each
+	};
+
+	const char* getName(CaseType);
+
+	// Differential fuzzing and timing of the narrow phase.  Every case is generated from
+	// the seed and its index alone, so both reproduce it.  Its two meshes are placed by the
+	// identity, by one random matrix for both or, for RANDOM and SOUP, by one each.
+	//
+	// The reference is Body::doesCollide over all pairs of triangles.  Each kernel (the
+	// TriangleTree of StaticBody and FixedRigidBody against bodies of its own and of any
+	// size) runs on the same bodies.  Kernels that test the pairs in the same order have to
+	// return the same contact to the bit; the tree only has to agree whether there is one.
+	//
+	// Constructs rigid bodies of its own, so it mustn't run alongside advanceState.
+	class NarrowPhaseHarness
+	{
+		public:
+
+		// A case on which a kernel disagrees with the reference, or on which the reference
+		// returns a contact that isn't finite.
+		struct Mismatch
+		{
+			std::uint64_t caseIndex;
+			CaseType type;
+			const char* kernel;
+			const char* problem;
+		};
+
+		NarrowPhaseHarness() = delete;
+		NarrowPhaseHarness(const NarrowPhaseHarness&) = delete;
+		explicit NarrowPhaseHarness(std::uint64_t seed) : seed{seed} {}
+
+		~NarrowPhaseHarness() = default;
+
+		NarrowPhaseHarness& operator=(const NarrowPhaseHarness&) = delete;
+
+		// Run the reference and every kernel on the cases from begin to end.
+		std::vector<Mismatch> fuzz(std::uint64_t begin, std::uint64_t end) const;
+
+		// Seconds the reference and each kernel take to test the cases from begin to end
+		// repetitions times, not counting generating the cases.
+		std::vector<std::pair<const char*, double>> time(std::uint64_t begin,
+			std::uint64_t end, unsigned repetitions) const;
+
+		// Write the global coordinates of the triangles of a case and what the reference and
+		// each kernel return for it.
+		void describe(std::ostream&, std::uint64_t caseIndex) const;
+
+		private:
+
+		struct Case;
+		struct Bodies;
+
+		// Kernel 0 is the reference.
+		static std::array<ThreeVector<float>, 2>* collide(const Bodies&, unsigned kernel);
+
+		const std::uint64_t seed;
+	};
+}
+
+#endif //NARROWPHASEHARNESS_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,461 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "pager.hpp"
+
+namespace nut
+{
+	constexpr unsigned Pager::noPools;
+
+	Pager::Pager(const std::string& directory, float pageSize, float loadRadius,
+		float evictRadius, std::size_t maxResidentPages) :
+		directory{directory}, pageSize{pageSize}, loadRadius{loadRadius},
+		evictRadius{std::max(evictRadius, loadRadius)}, maxResidentPages{maxResidentPages}
+	{
+		this->thread = std::thread{&Pager::run, this};
+	}
+
+	Pager::~Pager()
+	{
+		{
+			std::lock_guard<std::mutex> lock{this->mutex};
+			this->isStopping = true;
+		}
+
+		this->condition.notify_all();
+		this->thread.join();
+
+		// Pages read since the last update have been removed from disk already; write them
+		// back, and retry failed writes.  There's nobody to report an error to anymore.
+		for (const auto* jobs : {&this->finishedJobs, &this->failedJobs})
+		{
+			for (const auto& job : *jobs)
+			{
+				if (jobs == &this->failedJobs && job.isRead)
+					continue;
+
+				try
+				{
+					Pager::write(this->getFileName(job.page), job.records);
+				}
+				catch (const std::runtime_error&) {}
+			}
+		}
+	}
+
+	unsigned Pager::addPools(const Body::Pool& bodyPool,
+		const RigidBody::Pool& rigidBodyPool)
+	{
+		this->pools.emplace_back(bodyPool, rigidBodyPool);
+		return static_cast<unsigned>(this->pools.size() - 1u);
+	}
+
+	RigidBody& Pager::createBody(float mass, const float(& momentOfInertia)[3],
+		const ModelViewMatrix<float>& modelViewMatrix, const ThreeVector<float>& velocity,
+		float angularFrequency, const ThreeVector<float>& rotationAxis, const Shape& shape)
+	{
+		this->bodies.push_back(ResidentBody{std::unique_ptr<RigidBody>{new RigidBody{mass,
+			momentOfInertia, modelViewMatrix, velocity, angularFrequency, rotationAxis, shape}},
+			Pager::noPools});
+
+		// A page a body is created in counts as in memory, even if it has a file.
+		this->pages.emplace(this->getPage(&modelViewMatrix[12]), true);
+
+		return *this->bodies.back().body;
+	}
+
+	RigidBody& Pager::createBody(float mass, const float(& momentOfInertia)[3],
+		const ModelViewMatrix<float>& modelViewMatrix, const ThreeVector<float>& velocity,
+		float angularFrequency, const ThreeVector<float>& rotationAxis, unsigned pools)
+	{
+		const auto& pool = this->pools.at(pools);
+
+		this->bodies.push_back(ResidentBody{std::unique_ptr<RigidBody>{new RigidBody{mass,
+			momentOfInertia, modelViewMatrix, velocity, angularFrequency, rotationAxis,
+			pool.first, pool.second}}, pools});
+
+		this->pages.emplace(this->getPage(&modelViewMatrix[12]), true);
+
+		return *this->bodies.back().body;
+	}
+
+	std::vector<RigidBody*> Pager::getBodies() const
+	{
+		std::vector<RigidBody*> bodies;
+
+		for (const auto& i : this->bodies)
+			bodies.push_back(i.body.get());
+
+		return bodies;
+	}
+
+	Pager::Page Pager::getPage(const float point[3]) const
+	{
+		return Page{static_cast<int>(std::floor(point[0] / this->pageSize)),
+			static_cast<int>(std::floor(point[1] / this->pageSize)),
+			static_cast<int>(std::floor(point[2] / this->pageSize))};
+	}
+
+	float Pager::getDistance2(const Page& page, const ThreeVector<float>& point) const
+	{
+		const int index[3] = {std::get<0>(page), std::get<1>(page), std::get<2>(page)};
+		float distance2 = .0f;
+
+		for (int i = 0; i != 3; ++i)
+		{
+			float min = index[i] * this->pageSize;
+			float offset = std::max({min - point[i], point[i] - (min + this->pageSize), .0f});
+			distance2 += offset * offset;
+		}
+
+		return distance2;
+	}
+
+	std::string Pager::getFileName(const Page& page) const
+	{
+		return this->directory + "/page_" + std::to_string(std::get<0>(page)) + "_" +
+			std::to_string(std::get<1>(page)) + "_" + std::to_string(std::get<2>(page));
+	}
+
+	Pager::Record Pager::freeze(const ResidentBody& residentBody) const
+	{
+		const RigidBody& body = *residentBody.body;
+		Record record;
+
+		record.shape = body.getShape();
+		record.pools = residentBody.pools;
+		record.collisionFilter = body.getCollisionFilter();
+		record.mass = body.getMass();
+		std::copy(body.getMomentOfInertia(), body.getMomentOfInertia() + 3,
+			record.momentOfInertia);
+
+		const ModelViewMatrix<float>& modelViewMatrix = body.getObjectMatrix();
+
+		for (int column = 0; column != 4; ++column)
+		{
+			for (int row = 0; row != 3; ++row)
+				record.modelViewMatrix[3 * column + row] = modelViewMatrix[4 * column + row];
+		}
+
+		const ThreeVector<float>& velocity = body.getVelocity();
+		std::copy(velocity + 0, velocity + 3, record.velocity);
+		record.angularFrequency = body.getAngularFrequency();
+		const ThreeVector<float>& rotationAxis = body.getRotationAxis();
+		std::copy(rotationAxis + 0, rotationAxis + 3, record.rotationAxis);
+
+		return record;
+	}
+
+	void Pager::thaw(const Record& record)
+	{
+		const float (& entries)[12] = record.modelViewMatrix;
+		const ModelViewMatrix<float> modelViewMatrix{{
+			entries[0], entries[1], entries[2], .0f,
+			entries[3], entries[4], entries[5], .0f,
+			entries[6], entries[7], entries[8], .0f,
+			entries[9], entries[10], entries[11], 1.f}};
+		const ThreeVector<float> velocity{&record.velocity[0]};
+		const ThreeVector<float> rotationAxis{&record.rotationAxis[0]};
+
+		if (record.pools == Pager::noPools)
+		{
+			this->createBody(record.mass, record.momentOfInertia, modelViewMatrix, velocity,
+				record.angularFrequency, rotationAxis, record.shape);
+		}
+		else
+		{
+			this->createBody(record.mass, record.momentOfInertia, modelViewMatrix, velocity,
+				record.angularFrequency, rotationAxis, record.pools);
+		}
+
+		this->bodies.back().body->getCollisionFilter() = record.collisionFilter;
+	}
+
+	// Recreate the bodies of the pages read.
+	void Pager::collect()
+	{
+		std::vector<Job> finishedJobs, failedJobs;
+		std::exception_ptr error;
+
+		{
+			std::lock_guard<std::mutex> lock{this->mutex};
+
+			finishedJobs.swap(this->finishedJobs);
+			failedJobs.swap(this->failedJobs);
+			std::swap(error, this->error);
+		}
+
+		// A page that couldn't be read is forgotten, so it's asked for again, and the bodies
+		// that couldn't be written are recreated, so they're written again when evicted.
+		for (const auto& job : failedJobs)
+		{
+			if (job.isRead)
+			{
+				auto page = this->pages.find(job.page);
+
+				if (page != this->pages.end() && !page->second)
+					this->pages.erase(page);
+			}
+			else
+			{
+				for (const auto& record : job.records)
+					this->thaw(record);
+			}
+		}
+
+		// Pages evicted before they were read go straight back.
+		std::vector<Job> writes;
+
+		for (auto& job : finishedJobs)
+		{
+			auto page = this->pages.find(job.page);
+
+			if (page == this->pages.end())
+			{
+				if (!job.records.empty())
+					writes.push_back(Job{job.page, false, std::move(job.records)});
+
+				continue;
+			}
+
+			for (const auto& record : job.records)
+				this->thaw(record);
+
+			page->second = true;
+		}
+
+		if (!writes.empty())
+		{
+			{
+				std::lock_guard<std::mutex> lock{this->mutex};
+
+				for (auto& job : writes)
+					this->jobs.push_back(std::move(job));
+			}
+
+			this->condition.notify_all();
+		}
+
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	void Pager::update(const std::vector<ThreeVector<float>>& interests)
+	{
+		this->collect();
+
+		// Pages to keep, nearest first: those within loadRadius of a point of interest,
+		// then those in memory within evictRadius.
+		std::map<Page, float> distances2;
+
+		for (const auto& interest : interests)
+		{
+			const Page range[2] = {
+				this->getPage(ThreeVector<float>{interest - ThreeVector<float>{
+					this->loadRadius, this->loadRadius, this->loadRadius}}),
+				this->getPage(ThreeVector<float>{interest + ThreeVector<float>{
+					this->loadRadius, this->loadRadius, this->loadRadius}})};
+
+			for (int x = std::get<0>(range[0]); x <= std::get<0>(range[1]); ++x)
+			{
+				for (int y = std::get<1>(range[0]); y <= std::get<1>(range[1]); ++y)
+				{
+					for (int z = std::get<2>(range[0]); z <= std::get<2>(range[1]); ++z)
+					{
+						Page page{x, y, z};
+						float distance2 = this->getDistance2(page, interest);
+
+						if (distance2 > this->loadRadius * this->loadRadius)
+							continue;
+
+						auto i = distances2.emplace(page, distance2).first;
+						i->second = std::min(i->second, distance2);
+					}
+				}
+			}
+		}
+
+		std::vector<std::pair<float, Page>> wanted, kept;
+
+		for (const auto& i : distances2)
+			wanted.emplace_back(i.second, i.first);
+
+		for (const auto& i : this->pages)
+		{
+			if (distances2.count(i.first))
+				continue;
+
+			float distance2 = std::numeric_limits<float>::infinity();
+			for (const auto& interest : interests)
+				distance2 = std::min(distance2, this->getDistance2(i.first, interest));
+
+			if (distance2 <= this->evictRadius * this->evictRadius)
+				kept.emplace_back(distance2, i.first);
+		}
+
+		std::sort(wanted.begin(), wanted.end());
+		std::sort(kept.begin(), kept.end());
+		wanted.insert(wanted.end(), kept.begin(), kept.end());
+		wanted.resize(std::min(wanted.size(), this->maxResidentPages));
+
+		std::map<Page, bool> pages;
+		std::vector<Job> newJobs;
+
+		for (const auto& i : wanted)
+		{
+			auto page = this->pages.find(i.second);
+
+			if (page != this->pages.end())
+			{
+				pages.insert(*page);
+			}
+			else
+			{
+				pages.emplace(i.second, false);
+				newJobs.push_back(Job{i.second, true, {}});
+			}
+		}
+
+		// Freeze the bodies of all other pages.
+		std::map<Page, std::vector<Record>> frozen;
+
+		this->bodies.erase(std::remove_if(this->bodies.begin(), this->bodies.end(),
+			[this, &pages, &frozen](const ResidentBody& body) {
+				Page page = this->getPage(&body.body->getObjectMatrix()[12]);
+				if (pages.count(page))
+					return false;
+
+				frozen[page].push_back(this->freeze(body));
+				return true;
+			}), this->bodies.end());
+
+		this->pages = std::move(pages);
+
+		// Writes go first, so pages evicted earlier are complete when read.
+		{
+			std::lock_guard<std::mutex> lock{this->mutex};
+
+			for (auto& i : frozen)
+				this->jobs.push_back(Job{i.first, false, std::move(i.second)});
+			for (auto& job : newJobs)
+				this->jobs.push_back(std::move(job));
+		}
+
+		this->condition.notify_all();
+	}
+
+	void Pager::finish()
+	{
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock{this->mutex};
+				this->condition.wait(lock, [this] { return this->jobs.empty(); });
+
+				if (this->finishedJobs.empty() && !this->error)
+					return;
+			}
+
+			this->collect();
+		}
+	}
+
+	void Pager::write(const std::string& fileName, const std::vector<Record>& records)
+	{
+		if (records.empty())
+			return;
+
+		std::ofstream file{fileName, std::ios::binary | std::ios::app};
+
+		file.write(reinterpret_cast<const char*>(records.data()),
+			static_cast<std::streamsize>(records.size() * sizeof(Record)));
+
+		file.flush();
+		if (!file)
+			throw std::runtime_error{"can't write " + fileName};
+	}
+
+	void Pager::run()
+	{
+		std::unique_lock<std::mutex> lock{this->mutex};
+
+		for (;;)
+		{
+			this->condition.wait(lock, [this] {
+				return this->isStopping || !this->jobs.empty();
+			});
+
+			// Pages are written even when stopping, so no bodies are lost.
+			if (this->jobs.empty())
+				return;
+
+			Job& job = this->jobs.front();
+			std::string fileName = this->getFileName(job.page);
+
+			lock.unlock();
+
+			try
+			{
+				if (job.isRead)
+				{
+					std::ifstream file{fileName, std::ios::binary};
+
+					if (file)
+					{
+						Record record;
+						while (file.read(reinterpret_cast<char*>(&record), sizeof record))
+							job.records.push_back(record);
+
+						if (!file.eof())
+							throw std::runtime_error{"can't read " + fileName};
+
+						file.close();
+						std::remove(fileName.c_str());
+					}
+				}
+				else
+					Pager::write(fileName, job.records);
+			}
+			catch (...)
+			{
+				lock.lock();
+				this->error = std::current_exception();
+				this->failedJobs.push_back(std::move(job));
+				this->jobs.pop_front();
+				this->condition.notify_all();
+				continue;
+			}
+
+			lock.lock();
+
+			if (job.isRead)
+				this->finishedJobs.push_back(std::move(job));
+
+			this->jobs.pop_front();
+			this->condition.notify_all();
+		}
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,181 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PAGER_HPP_SEEN
+#define PAGER_HPP_SEEN
+
+#include <condition_variable>
+#include <cstddef> // std::size_t
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "body.hpp"
+#include "contact.hpp"
+#include "rigidBody.hpp"
+#include "shape.hpp"
+#include "threeVector.hpp" // needs to precede modelViewMatrix.hpp
+#include "modelViewMatrix.hpp"
+
+namespace nut
+{
+	// Keeps only the rigid bodies near points of interest, e.g. players, in memory.  Space
+	// is divided into cubic pages; the bodies of pages farther than evictRadius from every
+	// point of interest are frozen and written to a file per page, and their memory freed.
+	// Pages within loadRadius are read back on a thread of their own and their bodies
+	// recreated, nearest first and at most maxResidentPages of them.
+	//
+	// A body belongs to the page its center is in, wherever it moves; bodies that move
+	// into a page that isn't in memory are added to its file.  Pools of meshes stay in
+	// memory and are referred to by index; add them in the same order when picking up the
+	// files of an earlier run.
+	class Pager
+	{
+		public:
+
+		Pager() = delete;
+		Pager(const Pager&) = delete;
+
+		// The files are put in directory, which has to exist.  evictRadius should be larger
+		// than loadRadius by a bit, so pages at the border aren't written and read again all
+		// the time.
+		Pager(const std::string& directory, float pageSize, float loadRadius,
+			float evictRadius, std::size_t maxResidentPages);
+
+		// Waits for the files to be written, and writes back the pages read since the last
+		// update.  Bodies in memory are destroyed; call update without points of interest
+		// first to keep them.
+		~Pager();
+
+		Pager& operator=(const Pager&) = delete;
+
+		// Returns the index to create bodies of the pools with.  They have to outlive the
+		// pager.
+		unsigned addPools(const Body::Pool&, const RigidBody::Pool&);
+
+		// Create a body in memory.
+		RigidBody& createBody(float mass, const float(& momentOfInertia)[3],
+			const ModelViewMatrix<float>& modelViewMatrix, const ThreeVector<float>& velocity,
+			float angularFrequency, const ThreeVector<float>& rotationAxis, const Shape&);
+
+		RigidBody& createBody(float mass, const float(& momentOfInertia)[3],
+			const ModelViewMatrix<float>& modelViewMatrix, const ThreeVector<float>& velocity,
+			float angularFrequency, const ThreeVector<float>& rotationAxis, unsigned pools);
+
+		// Recreate the bodies of pages read since the last call, then evict and start
+		// reading pages for the points of interest.  Call it between steps.  Rethrows
+		// std::runtime_error once if a file couldn't be read or written; a page that
+		// couldn't be read is read again by a later call, and bodies that couldn't be
+		// written are recreated in memory.
+		void update(const std::vector<ThreeVector<float>>& interests);
+
+		// Block until all pages being read or written are done, and recreate the bodies of
+		// those read.
+		void finish();
+
+		// The bodies in memory.  Eviction destroys them.
+		std::vector<RigidBody*> getBodies() const;
+
+		// Pages in memory or being read.
+		std::size_t getResidentPageCount() const { return this->pages.size(); }
+
+		private:
+
+		typedef std::tuple<int, int, int> Page;
+
+		// A frozen body, as it's written to the files.
+		struct Record
+		{
+			Shape shape; // if pools is noPools
+			unsigned pools;
+			CollisionFilter collisionFilter;
+			float mass;
+			float momentOfInertia[3];
+			float modelViewMatrix[12]; // the first three rows; the last is 0 0 0 1
+			float velocity[3];
+			float angularFrequency;
+			float rotationAxis[3];
+		};
+
+		static constexpr unsigned noPools = ~0u;
+
+		struct ResidentBody
+		{
+			std::unique_ptr<RigidBody> body;
+			unsigned pools;
+		};
+
+		// Append records to the file of the page, or read and remove it.
+		struct Job
+		{
+			Page page;
+			bool isRead;
+			std::vector<Record> records;
+		};
+
+		Page getPage(const float point[3]) const;
+
+		// Squared distance of the point to the page.
+		float getDistance2(const Page&, const ThreeVector<float>& point) const;
+
+		std::string getFileName(const Page&) const;
+
+		Record freeze(const ResidentBody&) const;
+
+		void thaw(const Record&);
+
+		void collect();
+
+		// Append the records to the file.
+		static void write(const std::string& fileName, const std::vector<Record>&);
+
+		void run();
+
+		const std::string directory;
+		const float pageSize;
+		const float loadRadius;
+		const float evictRadius;
+		const std::size_t maxResidentPages;
+
+		std::deque<std::pair<Body::Pool, RigidBody::Pool>> pools; // never move
+
+		std::vector<ResidentBody> bodies;
+
+		// true if in memory, false if being read
+		std::map<Page, bool> pages;
+
+		// shared with the thread
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<Job> jobs; // the first one is in progress
+		std::vector<Job> finishedJobs;
+		std::vector<Job> failedJobs; // records of reads are partial
+		std::exception_ptr error; // of the last failed job
+		bool isStopping = false;
+
+		std::thread thread;
+	};
+}
+
+#endif //PAGER_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
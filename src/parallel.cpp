@@ -0,0 +1,89 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "parallel.hpp"
+
+namespace nut
+{
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock{this->mutex};
+			this->isStopping = true;
+		}
+
+		this->condition.notify_all();
+
+		for (auto& thread : this->threads)
+			thread.join();
+	}
+
+	void ThreadPool::run(unsigned count, const std::function<void(unsigned)>& function)
+	{
+		while (this->threads.size() + 1u < count)
+		{
+			this->threads.emplace_back(&ThreadPool::work, this,
+				static_cast<unsigned>(this->threads.size() + 1u), this->generation);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{this->mutex};
+			this->function = &function;
+			this->count = count;
+			this->busy = count - 1u;
+			++this->generation;
+		}
+
+		this->condition.notify_all();
+
+		function(0u);
+
+		std::unique_lock<std::mutex> lock{this->mutex};
+		this->condition.wait(lock, [this] { return this->busy == 0u; });
+		this->function = nullptr;
+	}
+
+	void ThreadPool::work(unsigned index, unsigned long generation)
+	{
+		std::unique_lock<std::mutex> lock{this->mutex};
+
+		for (;;)
+		{
+			this->condition.wait(lock, [this, generation] {
+				return this->isStopping || this->generation != generation;
+			});
+
+			if (this->isStopping)
+				return;
+
+			generation = this->generation;
+
+			if (index >= this->count)
+				continue;
+
+			const std::function<void(unsigned)>& function = *this->function;
+
+			lock.unlock();
+			function(index);
+			lock.lock();
+
+			if (--this->busy == 0u)
+				this->condition.notify_all();
+		}
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
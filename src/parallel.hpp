@@ -0,0 +1,117 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PARALLEL_HPP_SEEN
+#define PARALLEL_HPP_SEEN
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nut
+{
+	// Run function(i) for each i in [0, count), all but the first one on a thread of its
+	// own.
+	template <typename Function>
+	void runInParallel(unsigned count, Function function)
+	{
+		std::vector<std::thread> threads;
+		for (unsigned i = 1u; i < count; ++i)
+			threads.emplace_back(function, i);
+		function(0u);
+		for (auto& thread : threads)
+			thread.join();
+	}
+
+	// Lets a fixed number of threads wait for each other, as often as needed.  Waiting
+	// spins, so this is meant for short phases of work on all hardware threads.
+	class Barrier
+	{
+		public:
+
+		Barrier() = delete;
+		Barrier(const Barrier&) = delete;
+		explicit Barrier(unsigned count) : count{count} {}
+
+		~Barrier() = default;
+
+		Barrier& operator=(const Barrier&) = delete;
+
+		void wait()
+		{
+			unsigned phase = this->phase.load();
+
+			if (this->waiting.fetch_add(1u) + 1u == this->count)
+			{
+				this->waiting.store(0u);
+				this->phase.fetch_add(1u);
+			}
+			else
+			{
+				while (this->phase.load() == phase)
+					std::this_thread::yield();
+			}
+		}
+
+		private:
+
+		const unsigned count;
+		std::atomic<unsigned> waiting{0u};
+		std::atomic<unsigned> phase{0u}; // how often all threads have met
+	};
+
+	// Runs functions in parallel like runInParallel, on threads that are kept for the next
+	// call instead of being started anew, for work that is repeated often, e.g. every
+	// substep.
+	class ThreadPool
+	{
+		public:
+
+		ThreadPool() = default;
+		ThreadPool(const ThreadPool&) = delete;
+
+		~ThreadPool();
+
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// Run function(i) for each i in [0, count), the first one on the calling thread, and
+		// wait for all of them.  Not to be called by more than one thread at a time.
+		void run(unsigned count, const std::function<void(unsigned)>& function);
+
+		private:
+
+		// Wait for calls of run after the given one.
+		void work(unsigned index, unsigned long generation);
+
+		std::vector<std::thread> threads; // run function(1) and on
+
+		// shared with the threads
+		std::mutex mutex;
+		std::condition_variable condition;
+		const std::function<void(unsigned)>* function = nullptr;
+		unsigned count = 0u;
+		unsigned busy = 0u; // threads that haven't finished their call yet
+		unsigned long generation = 0u; // how often run was called
+		bool isStopping = false;
+	};
+}
+
+#endif //PARALLEL_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
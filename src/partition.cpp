@@ -0,0 +1,300 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "partition.hpp"
+#include "rigidBody.hpp"
+
+namespace nut
+{
+	std::size_t partitionQueueCapacity = 4096u;
+
+	namespace
+	{
+		// Boxes contain their minimum but not their maximum, so a point on a border belongs
+		// to one region only.
+		bool doesContain(const AxisAlignedBox& box, const float point[3])
+		{
+			return box.min[0] <= point[0] && point[0] < box.max[0] &&
+				box.min[1] <= point[1] && point[1] < box.max[1] &&
+				box.min[2] <= point[2] && point[2] < box.max[2];
+		}
+
+		AxisAlignedBox expand(AxisAlignedBox box, float margin)
+		{
+			for (int i = 0; i != 3; ++i)
+			{
+				box.min[i] -= margin;
+				box.max[i] += margin;
+			}
+
+			return box;
+		}
+
+		std::string getQueueName(const std::string& name, unsigned from, unsigned to)
+		{
+			return "/" + name + "-" + std::to_string(from) + "-" + std::to_string(to);
+		}
+	}
+
+	Partition::Partition(const std::string& name,
+		const std::vector<AxisAlignedBox>& regions, unsigned index, float margin) :
+		region(regions.at(index)), index{index}, margin{margin}
+	{
+		for (unsigned i = 0u; i != regions.size(); ++i)
+		{
+			if (i == index || !doOverlap(expand(this->region, margin), regions[i]))
+				continue;
+
+			// Each region creates the queues to its neighbours before opening those from
+			// them, so no two wait for each other.
+			this->neighbours.push_back(Neighbour{i, regions[i],
+				std::unique_ptr<SharedRingBuffer<Record>>{new SharedRingBuffer<Record>{
+					getQueueName(name, index, i), partitionQueueCapacity, true}},
+				nullptr, {}, false});
+		}
+
+		for (auto& neighbour : this->neighbours)
+		{
+			neighbour.incoming.reset(new SharedRingBuffer<Record>{
+				getQueueName(name, neighbour.index, index), partitionQueueCapacity, false});
+		}
+	}
+
+	Partition::~Partition() = default;
+
+	RigidBody& Partition::createBody(float mass, const float(& momentOfInertia)[3],
+		const ModelViewMatrix<float>& modelViewMatrix, const ThreeVector<float>& velocity,
+		float angularFrequency, const ThreeVector<float>& rotationAxis, const Shape& shape)
+	{
+		if (shape.type == ShapeType::MESH)
+			throw std::runtime_error{"Partition: meshes can't move between processes"};
+
+		std::uint64_t id = std::uint64_t{this->index} << 32u | this->createdCount++;
+
+		auto& body = this->bodies[id];
+		body.reset(new RigidBody{mass, momentOfInertia, modelViewMatrix, velocity,
+			angularFrequency, rotationAxis, shape});
+
+		return *body;
+	}
+
+	void Partition::destroyBody(std::uint64_t id)
+	{
+		this->bodies.erase(id);
+		this->strays.erase(std::remove(this->strays.begin(), this->strays.end(), id),
+			this->strays.end());
+	}
+
+	Partition::Record Partition::makeRecord(RecordType type, std::uint64_t id,
+		const RigidBody& body)
+	{
+		Record record;
+
+		record.type = type;
+		record.id = id;
+		record.shape = body.shape;
+		record.collisionFilter = body.collisionFilter;
+		record.mass = body.mass;
+		std::copy(body.momentOfInertia, body.momentOfInertia + 3, record.momentOfInertia);
+		std::memcpy(record.modelViewMatrix, static_cast<const float*>(body.getObjectMatrix()),
+			sizeof record.modelViewMatrix);
+		std::memcpy(record.previousModelViewMatrix,
+			static_cast<const float*>(body.previousModelViewMatrix),
+			sizeof record.previousModelViewMatrix);
+		std::copy(body.velocity + 0, body.velocity + 3, record.velocity);
+		record.angularFrequency = body.angularFrequency;
+		std::copy(body.rotationAxis + 0, body.rotationAxis + 3, record.rotationAxis);
+
+		return record;
+	}
+
+	std::unique_ptr<RigidBody> Partition::makeBody(const Record& record)
+	{
+		std::unique_ptr<RigidBody> body{new RigidBody{record.mass, record.momentOfInertia,
+			ModelViewMatrix<float>{record.modelViewMatrix},
+			ThreeVector<float>{&record.velocity[0]}, record.angularFrequency,
+			ThreeVector<float>{&record.rotationAxis[0]}, record.shape}};
+
+		body->collisionFilter = record.collisionFilter;
+		Partition::setState(*body, record);
+
+		return body;
+	}
+
+	void Partition::setState(RigidBody& body, const Record& record)
+	{
+		body.getObjectMatrix() = ModelViewMatrix<float>{record.modelViewMatrix};
+		body.previousModelViewMatrix = ModelViewMatrix<float>{record.previousModelViewMatrix};
+		body.velocity = ThreeVector<float>{&record.velocity[0]};
+		body.angularFrequency = record.angularFrequency;
+		body.rotationAxis = ThreeVector<float>{&record.rotationAxis[0]};
+		body.transform();
+	}
+
+	void Partition::send(Neighbour& neighbour, const Record& record)
+	{
+		while (!neighbour.outgoing->push(record))
+		{
+			this->receive();
+			this->checkAlive(neighbour);
+			std::this_thread::yield();
+		}
+	}
+
+	void Partition::receive()
+	{
+		for (auto& neighbour : this->neighbours)
+		{
+			Record record;
+
+			// Records after the end belong to the next exchange, which the neighbour can't
+			// start before this one is over.
+			while (!neighbour.hasEnded && neighbour.incoming->pop(record))
+			{
+				if (record.type == RecordType::END)
+					neighbour.hasEnded = true;
+				else
+					neighbour.received.push_back(record);
+			}
+		}
+	}
+
+	void Partition::checkAlive(const Neighbour& neighbour)
+	{
+		// The neighbour created the queue it sends on.
+		if (!neighbour.incoming->isCreatorAlive())
+		{
+			throw std::runtime_error{"Partition: the process of region " +
+				std::to_string(neighbour.index) + " has died"};
+		}
+	}
+
+	void Partition::exchange()
+	{
+		this->strays.clear();
+
+		// Send ghosts and hand over bodies that left the region.
+		for (auto i = this->bodies.begin(); i != this->bodies.end();)
+		{
+			const float* center = &i->second->getObjectMatrix()[12];
+			Neighbour* owner = nullptr;
+
+			if (!doesContain(this->region, center))
+			{
+				for (auto& neighbour : this->neighbours)
+				{
+					if (doesContain(neighbour.region, center))
+						owner = &neighbour;
+				}
+
+				if (!owner)
+					this->strays.push_back(i->first);
+			}
+
+			for (auto& neighbour : this->neighbours)
+			{
+				if (&neighbour == owner)
+					this->send(neighbour, makeRecord(RecordType::HANDOVER, i->first, *i->second));
+				else if (doesContain(expand(neighbour.region, this->margin), center))
+					this->send(neighbour, makeRecord(RecordType::GHOST, i->first, *i->second));
+			}
+
+			if (owner)
+				i = this->bodies.erase(i);
+			else
+				++i;
+		}
+
+		Record end{};
+		end.type = RecordType::END;
+
+		for (auto& neighbour : this->neighbours)
+			this->send(neighbour, end);
+
+		// Wait for the neighbours to finish theirs.
+		for (;;)
+		{
+			this->receive();
+
+			if (std::all_of(this->neighbours.begin(), this->neighbours.end(),
+				[](const Neighbour& neighbour) { return neighbour.hasEnded; }))
+			{
+				break;
+			}
+
+			for (const auto& neighbour : this->neighbours)
+			{
+				// One may have sent its end and quit since receiving above, so its queue is
+				// drained once more before giving up on it.
+				if (!neighbour.hasEnded && !neighbour.incoming->isCreatorAlive())
+				{
+					this->receive();
+					if (!neighbour.hasEnded)
+						this->checkAlive(neighbour);
+				}
+			}
+
+			std::this_thread::yield();
+		}
+
+		// Apply them; ghosts that weren't sent again are gone.
+		std::map<std::uint64_t, std::unique_ptr<RigidBody>> ghosts;
+
+		for (auto& neighbour : this->neighbours)
+		{
+			for (const auto& record : neighbour.received)
+			{
+				auto ghost = this->ghosts.find(record.id);
+				std::unique_ptr<RigidBody> body;
+
+				if (ghost != this->ghosts.end())
+				{
+					body = std::move(ghost->second);
+					this->ghosts.erase(ghost);
+					Partition::setState(*body, record);
+				}
+				else
+				{
+					body = Partition::makeBody(record);
+				}
+
+				if (record.type == RecordType::HANDOVER)
+					this->bodies[record.id] = std::move(body);
+				else
+					ghosts[record.id] = std::move(body);
+			}
+
+			neighbour.received.clear();
+			neighbour.hasEnded = false;
+		}
+
+		this->ghosts = std::move(ghosts);
+	}
+
+	void Partition::advanceState(float timeInterval)
+	{
+		this->exchange();
+		RigidBody::advanceState(timeInterval);
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,173 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PARTITION_HPP_SEEN
+#define PARTITION_HPP_SEEN
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "axisAlignedBox.hpp"
+#include "contact.hpp"
+#include "sharedRingBuffer.hpp"
+#include "shape.hpp"
+#include "threeVector.hpp" // needs to precede modelViewMatrix.hpp
+#include "modelViewMatrix.hpp"
+
+namespace nut
+{
+	class RigidBody;
+
+	// Splits a world too big for one process between several on the same machine, each of
+	// which owns and steps the rigid bodies whose centers are within a region of its own.
+	// Regions exchange bodies through shared memory before each step, only with neighbours,
+	// the regions less than margin away:
+	// - Owned bodies whose centers are within margin of a neighbour are mirrored there as
+	//   ghosts, which collide with the bodies of the neighbour like any others but whose
+	//   state is replaced by the owner's before each step.
+	// - Owned bodies whose centers moved into a neighbour are handed over to it.  Those
+	//   that left the region but entered no neighbour, because they left all regions or
+	//   moved farther than margin, stay owned and are listed by getStrays().
+	//
+	// Every process runs the same steps in lockstep, waiting for its neighbours, and throws
+	// if one of them died rather than wait forever.  A pair of
+	// bodies on either side of a border is thus seen in the same state by both owners, each
+	// of which resolves the collision and keeps the result for its own body.  That is
+	// consistent as long as margin is larger than the bodies plus the distance they travel
+	// per step, so each owner sees everything that touches either body.
+	//
+	// Static bodies and heightfields are created by every process that needs them.  Only
+	// bodies with primitive shapes can be owned by a Partition; there's one per process.
+	class Partition
+	{
+		public:
+
+		Partition() = delete;
+		Partition(const Partition&) = delete;
+
+		// This process steps regions[index].  Regions mustn't overlap.  name tells the
+		// shared memory of different worlds apart.  Waits for the neighbours to be created.
+		Partition(const std::string& name, const std::vector<AxisAlignedBox>& regions,
+			unsigned index, float margin);
+
+		~Partition();
+
+		Partition& operator=(const Partition&) = delete;
+
+		// Create a body owned by this region.
+		RigidBody& createBody(float mass, const float(& momentOfInertia)[3],
+			const ModelViewMatrix<float>& modelViewMatrix, const ThreeVector<float>& velocity,
+			float angularFrequency, const ThreeVector<float>& rotationAxis, const Shape&);
+
+		// Destroy a body owned by this region, e.g. a stray.  Its ghosts are gone after the
+		// next exchange.
+		void destroyBody(std::uint64_t id);
+
+		// Exchange ghosts and handed over bodies with the neighbours, then advance all
+		// rigid bodies by timeInterval.  Throws std::runtime_error if the process of a
+		// neighbour has died; the partition can't step on after that.
+		void advanceState(float timeInterval);
+
+		// The bodies owned by this region, by an id that stays the same across regions.
+		const std::map<std::uint64_t, std::unique_ptr<RigidBody>>& getBodies() const {
+			return this->bodies;
+		}
+
+		// Copies of the bodies of neighbours; changing them is pointless.
+		const std::map<std::uint64_t, std::unique_ptr<RigidBody>>& getGhosts() const {
+			return this->ghosts;
+		}
+
+		// Ids of the owned bodies whose centers were outside the region at the last exchange
+		// but in no neighbour, so they couldn't be handed over.
+		const std::vector<std::uint64_t>& getStrays() const { return this->strays; }
+
+		private:
+
+		enum class RecordType : unsigned char
+		{
+			GHOST,
+			HANDOVER,
+			END // of the records of a step
+		};
+
+		struct Record
+		{
+			RecordType type;
+			std::uint64_t id;
+			Shape shape;
+			CollisionFilter collisionFilter;
+			float mass;
+			float momentOfInertia[3];
+			float modelViewMatrix[16];
+			float previousModelViewMatrix[16];
+			float velocity[3];
+			float angularFrequency;
+			float rotationAxis[3];
+		};
+
+		struct Neighbour
+		{
+			unsigned index;
+			AxisAlignedBox region;
+			std::unique_ptr<SharedRingBuffer<Record>> outgoing;
+			std::unique_ptr<SharedRingBuffer<Record>> incoming;
+			std::vector<Record> received; // in the current exchange
+			bool hasEnded; // sent all records of the current exchange
+		};
+
+		static Record makeRecord(RecordType, std::uint64_t id, const RigidBody&);
+
+		static std::unique_ptr<RigidBody> makeBody(const Record&);
+
+		// Set the state of the body, which was made from a record of the same id.
+		static void setState(RigidBody&, const Record&);
+
+		// Push to the neighbour, receiving from all of them while its queue is full so two
+		// regions never wait for each other.
+		void send(Neighbour&, const Record&);
+
+		// Pop what the neighbours sent so far.
+		void receive();
+
+		// Throw if the process of the neighbour has died.  Call it when waiting for it.
+		void checkAlive(const Neighbour&);
+
+		void exchange();
+
+		const AxisAlignedBox region;
+		const unsigned index;
+		const float margin;
+
+		std::vector<Neighbour> neighbours;
+
+		std::map<std::uint64_t, std::unique_ptr<RigidBody>> bodies;
+		std::map<std::uint64_t, std::unique_ptr<RigidBody>> ghosts;
+		std::vector<std::uint64_t> strays;
+
+		std::uint32_t createdCount = 0u; // the lower half of the ids of bodies created here
+	};
+
+	// Records each queue between two neighbouring regions holds.
+	extern std::size_t partitionQueueCapacity;
+}
+
+#endif //PARTITION_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,335 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <limits>
+#include <tuple>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "quantizedPool.hpp"
+
+namespace nut
+{
+	namespace
+	{
+		// Coordinates decoded at once.
+		constexpr unsigned batchSize = 4u;
+
+		// Octahedron coordinates from -1 to 1 map to 0 to 65534, so that 0 is exact.  Surface
+		// normals that are null vectors, those of degenerate triangles, get the other one.
+		constexpr std::uint16_t nullNormal = 65535u;
+		constexpr float octahedronStep = 2.f / 65534.f;
+
+		unsigned pad(unsigned count)
+		{
+			return (count + batchSize - 1u) / batchSize * batchSize;
+		}
+
+		// The unnormalized surface normal at a point of the octahedron; its inverse is below.
+		ThreeVector<float> unfold(float u, float v)
+		{
+			float z = 1.f - std::fabs(u) - std::fabs(v);
+			float t = std::max(-z, .0f);
+			return ThreeVector<float>{u - std::copysign(t, u), v - std::copysign(t, v), z};
+		}
+
+		ThreeVector<float> decode(std::uint16_t u, std::uint16_t v)
+		{
+			if (u == nullNormal)
+				return ThreeVector<float>{.0f, .0f, .0f};
+
+			ThreeVector<float> normal = unfold(u * octahedronStep - 1.f,
+				v * octahedronStep - 1.f);
+			return normal / normal.getNorm();
+		}
+
+		// Of the four nearest points of the octahedron, take the one that decodes closest to
+		// the unit vector.
+		void encode(const ThreeVector<float>& normal, std::uint16_t& u, std::uint16_t& v)
+		{
+			float norm = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+
+			if (norm == .0f)
+			{
+				u = v = nullNormal;
+				return;
+			}
+
+			float point[2] = {normal[0] / norm, normal[1] / norm};
+
+			if (normal[2] < .0f)
+			{
+				float x = point[0];
+				point[0] = (1.f - std::fabs(point[1])) * std::copysign(1.f, x);
+				point[1] = (1.f - std::fabs(x)) * std::copysign(1.f, point[1]);
+			}
+
+			float best = -std::numeric_limits<float>::infinity();
+
+			for (int i = 0; i != 4; ++i)
+			{
+				std::uint16_t candidate[2];
+
+				for (int j = 0; j != 2; ++j)
+				{
+					float code = (point[j] + 1.f) / octahedronStep;
+					code = i >> j & 1 ? std::ceil(code) : std::floor(code);
+					candidate[j] = static_cast<std::uint16_t>(std::min(std::max(code, .0f),
+						65534.f));
+				}
+
+				float cosine = decode(candidate[0], candidate[1]) * normal;
+
+				if (cosine > best)
+				{
+					best = cosine;
+					u = candidate[0];
+					v = candidate[1];
+				}
+			}
+		}
+	}
+
+	QuantizedPool::QuantizedPool(const Body::Pool& bodyPool,
+		const RigidBody::Pool& rigidBodyPool) :
+		vertexCount{std::get<2>(rigidBodyPool)},
+		triangleCount{static_cast<unsigned>(std::get<1>(bodyPool))},
+		origin{.0f, .0f, .0f}, step{.0f, .0f, .0f}, boundingRadius{.0f},
+		block(3u * pad(this->vertexCount) + 2u * pad(this->triangleCount)),
+		bodyPool(bodyPool), rigidBodyPool{nullptr, nullptr, this->vertexCount}
+	{
+		const ThreeVector<float>* vertices = std::get<0>(rigidBodyPool);
+		const ThreeVector<float>* surfaceNormals = std::get<1>(rigidBodyPool);
+
+		for (unsigned axis = 0; axis != 3; ++axis)
+		{
+			if (!this->vertexCount)
+				break;
+
+			auto bounds = std::minmax_element(vertices, vertices + this->vertexCount,
+				[axis](const ThreeVector<float>& a, const ThreeVector<float>& b) {
+					return a[axis] < b[axis];
+				});
+
+			this->origin[axis] = (*bounds.first)[axis];
+			this->step[axis] = ((*bounds.second)[axis] - (*bounds.first)[axis]) / 65535.f;
+
+			std::uint16_t* coordinates = this->block.data() + axis * pad(this->vertexCount);
+
+			for (unsigned i = 0; i != this->vertexCount; ++i)
+			{
+				float coordinate = this->step[axis] == .0f ? .0f :
+					std::round((vertices[i][axis] - this->origin[axis]) / this->step[axis]);
+				coordinates[i] = static_cast<std::uint16_t>(std::min(std::max(coordinate, .0f),
+					65535.f));
+			}
+		}
+
+		for (unsigned i = 0; i != this->vertexCount; ++i)
+		{
+			this->boundingRadius = std::max(this->boundingRadius,
+				this->getVertex(i).getNorm());
+		}
+
+		std::uint16_t* octahedronCoordinates[2] = {
+			this->block.data() + 3u * pad(this->vertexCount),
+			this->block.data() + 3u * pad(this->vertexCount) + pad(this->triangleCount)};
+
+		for (unsigned i = 0; i != this->triangleCount; ++i)
+		{
+			encode(surfaceNormals[i], octahedronCoordinates[0][i],
+				octahedronCoordinates[1][i]);
+		}
+	}
+
+	ThreeVector<float> QuantizedPool::getVertex(unsigned i) const
+	{
+		return ThreeVector<float>{
+			this->origin[0] + this->step[0] * this->getCoordinates(0)[i],
+			this->origin[1] + this->step[1] * this->getCoordinates(1)[i],
+			this->origin[2] + this->step[2] * this->getCoordinates(2)[i]};
+	}
+
+	ThreeVector<float> QuantizedPool::getSurfaceNormal(unsigned i) const
+	{
+		return decode(this->getOctahedronCoordinates(0)[i],
+			this->getOctahedronCoordinates(1)[i]);
+	}
+
+	std::size_t QuantizedPool::getSize() const
+	{
+		return this->block.size() * sizeof(std::uint16_t);
+	}
+
+	const std::uint16_t* QuantizedPool::getCoordinates(unsigned axis) const
+	{
+		return this->block.data() + axis * pad(this->vertexCount);
+	}
+
+	const std::uint16_t* QuantizedPool::getOctahedronCoordinates(unsigned axis) const
+	{
+		return this->block.data() + 3u * pad(this->vertexCount) +
+			axis * pad(this->triangleCount);
+	}
+
+	void QuantizedPool::transform(const ModelViewMatrix<float>& matrix,
+		ThreeVector<float> vertices[], ThreeVector<float> surfaceNormals[]) const
+	{
+		// The matrix with the dequantization folded in: columns scaled by the steps and the
+		// origin moved to the translation.
+		float scaled[12];
+		for (int i = 0; i != 9; ++i)
+			scaled[i] = matrix[i / 3 * 4 + i % 3] * this->step[i / 3];
+
+		for (int row = 0; row != 3; ++row)
+		{
+			scaled[9 + row] = matrix[row] * this->origin[0] +
+				matrix[4 + row] * this->origin[1] + matrix[8 + row] * this->origin[2] +
+				matrix[12 + row];
+		}
+
+		const std::uint16_t* const coordinates[3] = {
+			this->getCoordinates(0), this->getCoordinates(1), this->getCoordinates(2)};
+		const std::uint16_t* const octahedronCoordinates[2] = {
+			this->getOctahedronCoordinates(0), this->getOctahedronCoordinates(1)};
+
+		unsigned i = 0;
+
+#ifdef __SSE2__
+		// Four at a time, transposed to triples on the way out.  Each store runs one float
+		// into the next vertex, which the next store overwrites, so the last batch is left to
+		// the loop below.
+		const __m128i zero = _mm_setzero_si128();
+
+		for (; i + batchSize < this->vertexCount; i += batchSize)
+		{
+			__m128 decoded[3];
+			for (int axis = 0; axis != 3; ++axis)
+			{
+				decoded[axis] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64(
+					reinterpret_cast<const __m128i*>(coordinates[axis] + i)), zero));
+			}
+
+			__m128 global[4];
+			for (int row = 0; row != 3; ++row)
+			{
+				global[row] = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(_mm_set1_ps(scaled[row]), decoded[0]),
+					_mm_mul_ps(_mm_set1_ps(scaled[3 + row]), decoded[1])),
+					_mm_mul_ps(_mm_set1_ps(scaled[6 + row]), decoded[2])),
+					_mm_set1_ps(scaled[9 + row]));
+			}
+			global[3] = _mm_setzero_ps();
+
+			_MM_TRANSPOSE4_PS(global[0], global[1], global[2], global[3]);
+
+			for (unsigned j = 0; j != batchSize; ++j)
+				_mm_storeu_ps(vertices[i + j], global[j]);
+		}
+#endif
+
+		for (; i != this->vertexCount; ++i)
+		{
+			const float decoded[3] = {static_cast<float>(coordinates[0][i]),
+				static_cast<float>(coordinates[1][i]), static_cast<float>(coordinates[2][i])};
+
+			for (int row = 0; row != 3; ++row)
+			{
+				vertices[i][row] = scaled[row] * decoded[0] + scaled[3 + row] * decoded[1] +
+					scaled[6 + row] * decoded[2] + scaled[9 + row];
+			}
+		}
+
+		i = 0;
+
+#ifdef __SSE2__
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 step = _mm_set1_ps(octahedronStep);
+		const __m128 signBit = _mm_set1_ps(-.0f);
+		const __m128i null = _mm_set1_epi32(nullNormal);
+
+		for (; i + batchSize < this->triangleCount; i += batchSize)
+		{
+			__m128i code[2];
+			__m128 point[2];
+			for (int axis = 0; axis != 2; ++axis)
+			{
+				code[axis] = _mm_unpacklo_epi16(_mm_loadl_epi64(
+					reinterpret_cast<const __m128i*>(octahedronCoordinates[axis] + i)), zero);
+				point[axis] = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(code[axis]), step), one);
+			}
+
+			// as unfold above
+			__m128 normal[3];
+			normal[2] = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(signBit, point[0])),
+				_mm_andnot_ps(signBit, point[1]));
+			__m128 t = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), normal[2]), _mm_setzero_ps());
+			for (int axis = 0; axis != 2; ++axis)
+			{
+				normal[axis] = _mm_sub_ps(point[axis],
+					_mm_or_ps(t, _mm_and_ps(signBit, point[axis])));
+			}
+
+			__m128 norm = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(normal[0], normal[0]), _mm_mul_ps(normal[1], normal[1])),
+				_mm_mul_ps(normal[2], normal[2])));
+			__m128 isNull = _mm_castsi128_ps(_mm_cmpeq_epi32(code[0], null));
+
+			__m128 global[4];
+			for (int row = 0; row != 3; ++row)
+			{
+				global[row] = _mm_andnot_ps(isNull, _mm_div_ps(_mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(_mm_set1_ps(matrix[row]), normal[0]),
+					_mm_mul_ps(_mm_set1_ps(matrix[4 + row]), normal[1])),
+					_mm_mul_ps(_mm_set1_ps(matrix[8 + row]), normal[2])), norm));
+			}
+			global[3] = _mm_setzero_ps();
+
+			_MM_TRANSPOSE4_PS(global[0], global[1], global[2], global[3]);
+
+			for (unsigned j = 0; j != batchSize; ++j)
+				_mm_storeu_ps(surfaceNormals[i + j], global[j]);
+		}
+#endif
+
+		for (; i != this->triangleCount; ++i)
+		{
+			if (octahedronCoordinates[0][i] == nullNormal)
+			{
+				surfaceNormals[i] = ThreeVector<float>{.0f, .0f, .0f};
+				continue;
+			}
+
+			ThreeVector<float> normal = unfold(octahedronCoordinates[0][i] * octahedronStep -
+				1.f, octahedronCoordinates[1][i] * octahedronStep - 1.f);
+			float norm = normal.getNorm();
+
+			for (int row = 0; row != 3; ++row)
+			{
+				surfaceNormals[i][row] = (matrix[row] * normal[0] + matrix[4 + row] * normal[1] +
+					matrix[8 + row] * normal[2]) / norm;
+			}
+		}
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,102 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QUANTIZEDPOOL_HPP_SEEN
+#define QUANTIZEDPOOL_HPP_SEEN
+
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <vector>
+
+#include "body.hpp"
+#include "threeVector.hpp" // needs to precede modelViewMatrix.hpp
+#include "modelViewMatrix.hpp"
+#include "rigidBody.hpp"
+
+namespace nut
+{
+	// The object coordinates of a pair of pools, compressed for meshes that aren't shared
+	// by many bodies.  Each coordinate of a vertex is quantized to 16 bits over the bounds
+	// of the vertices, and each surface normal is encoded by its two 16-bit coordinates on
+	// an octahedron.  That's 6 rather than 12 bytes per vertex and 4 rather than 12 per
+	// surface normal.  The triangles stay in the Body::Pool, which has to outlive the
+	// QuantizedPool as it has to outlive bodies.
+	//
+	// Bodies constructed from it decode their vertices and surface normals as they're
+	// transformed, with the dequantization folded into the object matrix.  Vertices are off
+	// by at most half a quantization step, i.e. 1/131070 of the extent of the bounds along
+	// each axis, and surface normals by at most about 1/8000 of a radian.
+	class QuantizedPool
+	{
+		public:
+
+		QuantizedPool() = delete;
+		QuantizedPool(const QuantizedPool&) = delete;
+
+		// Encode the vertices and surface normals of the RigidBody::Pool, which may be freed
+		// afterwards.  Its surface normals are as many as the triangles of the Body::Pool.
+		QuantizedPool(const Body::Pool&, const RigidBody::Pool&);
+
+		QuantizedPool& operator=(const QuantizedPool&) = delete;
+
+		// decoded, in object coordinates
+		ThreeVector<float> getVertex(unsigned i) const;
+		ThreeVector<float> getSurfaceNormal(unsigned i) const;
+
+		unsigned getVertexCount() const { return this->vertexCount; }
+		unsigned getTriangleCount() const { return this->triangleCount; }
+
+		// of a sphere around the origin of object coordinates containing the decoded vertices
+		float getBoundingRadius() const { return this->boundingRadius; }
+
+		// Bytes taken by the encoded vertices and surface normals.
+		std::size_t getSize() const;
+
+		private:
+
+		friend class RigidBody;
+
+		// Decode the vertices and surface normals and transform them to global coordinates by
+		// the matrix, which mustn't scale.
+		void transform(const ModelViewMatrix<float>&, ThreeVector<float> vertices[],
+			ThreeVector<float> surfaceNormals[]) const;
+
+		// Coordinates of the vertices and surface normals from those of the block.
+		const std::uint16_t* getCoordinates(unsigned axis) const;
+		const std::uint16_t* getOctahedronCoordinates(unsigned axis) const;
+
+		unsigned vertexCount;
+		unsigned triangleCount;
+
+		// Vertices are origin + step * coordinates.
+		float origin[3];
+		float step[3];
+
+		float boundingRadius;
+
+		// the coordinates of the vertices along the x, y and z axis and those of the surface
+		// normals on the octahedron, one array after the other, each padded to be decoded in
+		// batches
+		std::vector<std::uint16_t> block;
+
+		const Body::Pool& bodyPool;
+		const RigidBody::Pool rigidBodyPool; // names the number of vertices only
+	};
+}
+
+#endif //QUANTIZEDPOOL_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
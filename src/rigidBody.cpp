@@ -14,13 +14,36 @@
    Dynamics.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <cstdlib>
+#include <algorithm>
+#include <cassert>
 
+#include "axisAlignedBox.hpp"
+#include "geometryArena.hpp"
+#include "heightfield.hpp"
+#include "quantizedPool.hpp"
 #include "rigidBody.hpp"
+#include "staticBody.hpp"
+#include "transformArray.hpp"
 
 namespace nut
 {
+	namespace
+	{
+		// Pools of primitives, which have no triangles.
+		const Body::Pool emptyBodyPool{nullptr, 0u};
+		const RigidBody::Pool emptyRigidBodyPool{nullptr, nullptr, 0u};
+
+		float getPoolBoundingRadius(const RigidBody::Pool& pool)
+		{
+			float radius = .0f;
+			for (unsigned i = 0; i != std::get<2>(pool); ++i)
+				radius = std::max(radius, std::get<0>(pool)[i].getNorm());
+			return radius;
+		}
+	}
+
 	std::vector<RigidBody*> RigidBody::rigidBodies;
+	unsigned long RigidBody::bodyChangeCount = 0u;
 
 	RigidBody::RigidBody(float mass, const float(& momentOfInertia)[3],
 		const ModelViewMatrix<float>& modelViewMatrix,
@@ -28,52 +51,368 @@ namespace nut
 		float angularFrequency, const ThreeVector<float>& rotationAxis,
 		const Body::Pool& bodyPool,
 		const RigidBody::Pool& rigidBodyPool) :
-			Body{reinterpret_cast<ThreeVector<float>*>(
-			     std::malloc(std::get<2>(rigidBodyPool) * sizeof(ThreeVector<float>))),
-			     reinterpret_cast<ThreeVector<float>*>(
-			     std::malloc(std::get<1>(bodyPool) * sizeof(ThreeVector<float>))),
-			     bodyPool},
-			pool(rigidBodyPool), modelViewMatrix{modelViewMatrix}, mass{mass},
+			Body{nullptr, nullptr, bodyPool},
+			pool{&rigidBodyPool}, shape{ShapeType::MESH, {}},
+			previousModelViewMatrix{modelViewMatrix},
+			boundingRadius{getPoolBoundingRadius(rigidBodyPool)}, mass{mass},
 			momentOfInertia{momentOfInertia[0], momentOfInertia[1], momentOfInertia[2]},
 			velocity(velocity), angularFrequency(angularFrequency),
 			rotationAxis(rotationAxis)
 	{
+		GeometryArena::allocate(*this, this->getVertexCount(), this->getTriangleCount());
+		this->transformIndex = TransformArray::allocate(*this, modelViewMatrix);
+		this->transform();
+
 		RigidBody::rigidBodies.push_back(this);
+		++RigidBody::bodyChangeCount;
+	}
+
+	RigidBody::RigidBody(float mass, const float(& momentOfInertia)[3],
+		const ModelViewMatrix<float>& modelViewMatrix,
+		const ThreeVector<float>& velocity,
+		float angularFrequency, const ThreeVector<float>& rotationAxis,
+		const Body::Pool& bodyPool, const RigidBody::Pool& rigidBodyPool,
+		ThreeVector<float> vertices[], ThreeVector<float> surfaceNormals[],
+		const Kernels& kernels) :
+			Body{vertices, surfaceNormals, bodyPool},
+			pool{&rigidBodyPool}, kernels{&kernels}, shape{ShapeType::MESH, {}},
+			previousModelViewMatrix{modelViewMatrix},
+			boundingRadius{getPoolBoundingRadius(rigidBodyPool)}, mass{mass},
+			momentOfInertia{momentOfInertia[0], momentOfInertia[1], momentOfInertia[2]},
+			velocity(velocity), angularFrequency(angularFrequency),
+			rotationAxis(rotationAxis)
+	{
+		this->transformIndex = TransformArray::allocate(*this, modelViewMatrix);
+		this->transform();
+
+		RigidBody::rigidBodies.push_back(this);
+		++RigidBody::bodyChangeCount;
+	}
+
+	RigidBody::RigidBody(float mass, const float(& momentOfInertia)[3],
+		const ModelViewMatrix<float>& modelViewMatrix,
+		const ThreeVector<float>& velocity,
+		float angularFrequency, const ThreeVector<float>& rotationAxis,
+		const Shape& shape) :
+			Body{nullptr, nullptr, emptyBodyPool},
+			pool{&emptyRigidBodyPool}, shape(shape),
+			previousModelViewMatrix{modelViewMatrix},
+			boundingRadius{nut::getBoundingRadius(shape)}, mass{mass},
+			momentOfInertia{momentOfInertia[0], momentOfInertia[1], momentOfInertia[2]},
+			velocity(velocity), angularFrequency(angularFrequency),
+			rotationAxis(rotationAxis)
+	{
+		// Nothing to transform, but the arena keeps track of every body.
+		GeometryArena::allocate(*this, 0u, 0u);
+		this->transformIndex = TransformArray::allocate(*this, modelViewMatrix);
+
+		RigidBody::rigidBodies.push_back(this);
+		++RigidBody::bodyChangeCount;
+	}
+
+	RigidBody::RigidBody(float mass, const float(& momentOfInertia)[3],
+		const ModelViewMatrix<float>& modelViewMatrix,
+		const ThreeVector<float>& velocity,
+		float angularFrequency, const ThreeVector<float>& rotationAxis,
+		const QuantizedPool& quantizedPool) :
+			Body{nullptr, nullptr, quantizedPool.bodyPool},
+			pool{&quantizedPool.rigidBodyPool}, shape{ShapeType::MESH, {}},
+			quantizedPool{&quantizedPool},
+			previousModelViewMatrix{modelViewMatrix},
+			boundingRadius{quantizedPool.getBoundingRadius()}, mass{mass},
+			momentOfInertia{momentOfInertia[0], momentOfInertia[1], momentOfInertia[2]},
+			velocity(velocity), angularFrequency(angularFrequency),
+			rotationAxis(rotationAxis)
+	{
+		GeometryArena::allocate(*this, this->getVertexCount(), this->getTriangleCount());
+		this->transformIndex = TransformArray::allocate(*this, modelViewMatrix);
+		this->transform();
+
+		RigidBody::rigidBodies.push_back(this);
+		++RigidBody::bodyChangeCount;
+	}
+
+	RigidBody::RigidBody(float mass, const float(& momentOfInertia)[3],
+		const ModelViewMatrix<float>& modelViewMatrix,
+		const ThreeVector<float>& velocity,
+		float angularFrequency, const ThreeVector<float>& rotationAxis,
+		const std::vector<CollisionLevel>& collisionLevels) :
+			Body{nullptr, nullptr, *collisionLevels.front().bodyPool},
+			pool{collisionLevels.front().rigidBodyPool}, shape{ShapeType::MESH, {}},
+			collisionLevels{&collisionLevels},
+			previousModelViewMatrix{modelViewMatrix}, boundingRadius{.0f}, mass{mass},
+			momentOfInertia{momentOfInertia[0], momentOfInertia[1], momentOfInertia[2]},
+			velocity(velocity), angularFrequency(angularFrequency),
+			rotationAxis(rotationAxis)
+	{
+		// Room for the largest level, and a bounding sphere around all of them so it doesn't
+		// change with the level.
+		std::size_t vertexCount = 0u, triangleCount = 0u;
+
+		for (const auto& level : collisionLevels)
+		{
+			vertexCount = std::max<std::size_t>(vertexCount, std::get<2>(*level.rigidBodyPool));
+			triangleCount = std::max(triangleCount, std::get<1>(*level.bodyPool));
+			this->boundingRadius = std::max(this->boundingRadius,
+				getPoolBoundingRadius(*level.rigidBodyPool));
+		}
+
+		GeometryArena::allocate(*this, vertexCount, triangleCount);
+		this->transformIndex = TransformArray::allocate(*this, modelViewMatrix);
+		this->transform();
+
+		RigidBody::rigidBodies.push_back(this);
+		++RigidBody::bodyChangeCount;
+	}
+
+	RigidBody::~RigidBody()
+	{
+		RigidBody::rigidBodies.erase(std::find(RigidBody::rigidBodies.begin(),
+			RigidBody::rigidBodies.end(), this));
+		++RigidBody::bodyChangeCount;
+
+		RigidBody::forgetContacts(this);
+
+		if (!this->kernels)
+			GeometryArena::release(*this);
+		TransformArray::release(this->transformIndex);
 	}
 
 	void RigidBody::move(float timeInterval)
 	{
-		this->modelViewMatrix[12] += this->velocity[0] * timeInterval;
-		this->modelViewMatrix[13] += this->velocity[1] * timeInterval;
-		this->modelViewMatrix[14] += this->velocity[2] * timeInterval;
+		this->getObjectMatrix()[12] += this->velocity[0] * timeInterval;
+		this->getObjectMatrix()[13] += this->velocity[1] * timeInterval;
+		this->getObjectMatrix()[14] += this->velocity[2] * timeInterval;
 
-		this->modelViewMatrix.rotate(this->angularFrequency * timeInterval,
+		this->getObjectMatrix().rotate(this->angularFrequency * timeInterval,
 			this->rotationAxis);
 
+		this->transform();
+	}
+
+	void RigidBody::transform()
+	{
+		if (this->kernels)
+		{
+			// They only fit the pools they were made for.
+			assert(!this->quantizedPool && !this->collisionLevels);
+			return this->kernels->transform(*this);
+		}
+
+		if (this->quantizedPool)
+		{
+			return this->quantizedPool->transform(this->getObjectMatrix(), this->vertices,
+				this->surfaceNormals);
+		}
+
 		// Transform members of body to new global coordinates.
 		for (unsigned i = 0; i != this->getVertexCount(); ++i)
 		{
-			this->vertices[i] = this->modelViewMatrix *
+			this->vertices[i] = this->getObjectMatrix() *
 				static_cast<ThreeVector<float, VERTEX>&>( // downcast
 					this->getVertex()[i]);
 			}
 
 		for (unsigned i = 0; i != this->getTriangleCount(); ++i)
 		{
-			this->surfaceNormals[i] = this->modelViewMatrix *
+			this->surfaceNormals[i] = this->getObjectMatrix() *
 				static_cast<ThreeVector<float, NORMAL>&>( // downcast
 					this->getSurfaceNormal()[i]);
 		}
 	}
 
+	RigidBody::State RigidBody::getState() const
+	{
+		return State{this->getObjectMatrix(), this->previousModelViewMatrix, this->velocity,
+			this->rotationAxis, this->angularFrequency, this->collisionLevel};
+	}
+
+	void RigidBody::setState(const State& state)
+	{
+		this->getObjectMatrix() = state.modelViewMatrix;
+		this->previousModelViewMatrix = state.previousModelViewMatrix;
+		this->velocity = state.velocity;
+		this->rotationAxis = state.rotationAxis;
+		this->angularFrequency = state.angularFrequency;
+
+		if (state.collisionLevel != this->collisionLevel)
+			this->useCollisionLevel(state.collisionLevel);
+
+		++this->generation;
+		this->transform();
+
+		TransformArray::markDirty(this->transformIndex);
+	}
+
+	bool RigidBody::mayCollide(const RigidBody& otherBody) const
+	{
+		if (!doCollide(this->collisionFilter, otherBody.collisionFilter))
+			return false;
+
+		ThreeVector<float> offset(ThreeVector<float>(this->getObjectMatrix() + 12) -
+			ThreeVector<float>(otherBody.getObjectMatrix() + 12));
+		float reach = this->boundingRadius + otherBody.boundingRadius;
+
+		return offset * offset <= reach * reach;
+	}
+
+	bool RigidBody::mayCollide(const StaticBody& staticBody) const
+	{
+		return doCollide(this->collisionFilter, staticBody.collisionFilter);
+	}
+
+	bool RigidBody::mayCollide(const Heightfield& heightfield) const
+	{
+		return doCollide(this->collisionFilter, heightfield.collisionFilter);
+	}
+
+	std::array<ThreeVector<float>, 2>*
+	RigidBody::doesCollide(const RigidBody& otherBody) const
+	{
+		if (this->shape.type == ShapeType::MESH)
+		{
+			if (otherBody.shape.type == ShapeType::MESH)
+			{
+				if (this->kernels)
+					return this->kernels->doesCollideWithMesh(*this, otherBody);
+
+				return this->Body::doesCollide(otherBody);
+			}
+
+			return this->doesCollide(otherBody.shape, otherBody.getObjectMatrix());
+		}
+
+		if (otherBody.shape.type == ShapeType::MESH)
+			return otherBody.doesCollide(this->shape, this->getObjectMatrix());
+
+		return nut::doesCollide(this->shape, this->getObjectMatrix(), otherBody.shape,
+			otherBody.getObjectMatrix());
+	}
+
+	std::array<ThreeVector<float>, 2>* RigidBody::doesCollide(const Shape& shape,
+		const ModelViewMatrix<float>& matrix) const
+	{
+		if (this->kernels)
+			return this->kernels->doesCollideWithShape(*this, shape, matrix);
+
+		AxisAlignedBox bounds = getBounds(shape, matrix);
+
+		for (unsigned i = 0; i != this->getTriangleCount(); ++i)
+		{
+			const ThreeVector<float>* const corners[3] = {
+				&this->vertices[this->getFaces()[i][0]],
+				&this->vertices[this->getFaces()[i][1]],
+				&this->vertices[this->getFaces()[i][2]]};
+
+			AxisAlignedBox box = getEmptyBox();
+			grow(box, *corners[0]);
+			grow(box, *corners[1]);
+			grow(box, *corners[2]);
+
+			if (!doOverlap(box, bounds))
+				continue;
+
+			// We take the first hit.
+			if (auto partialCollisionContext = nut::doesCollide(shape, matrix, corners))
+				return partialCollisionContext;
+		}
+		return nullptr;
+	}
+
+	std::array<ThreeVector<float>, 2>* RigidBody::doesCollide(const RigidBody& otherBody,
+		const TriangleTree& tree) const
+	{
+		return this->Body::doesCollide(otherBody, tree);
+	}
+
+	bool RigidBody::doesOverlap(const Shape& shape,
+		const ModelViewMatrix<float>& matrix) const
+	{
+		std::unique_ptr<std::array<ThreeVector<float>, 2>> partialCollisionContext{
+			this->shape.type == ShapeType::MESH ? this->doesCollide(shape, matrix) :
+				nut::doesCollide(shape, matrix, this->shape, this->getObjectMatrix())};
+
+		return partialCollisionContext != nullptr;
+	}
+
+	std::array<ThreeVector<float>, 2>*
+	RigidBody::doesCollide(const StaticBody& staticBody) const
+	{
+		if (this->shape.type == ShapeType::MESH)
+			return this->Body::doesCollide(staticBody, staticBody.tree);
+
+		std::array<ThreeVector<float>, 2>* partialCollisionContext = nullptr;
+
+		staticBody.tree.visitOverlaps(getBounds(this->shape, this->getObjectMatrix()),
+			[&](unsigned i) {
+				const ThreeVector<float>* const corners[3] = {
+					&staticBody.vertices[staticBody.getFaces()[i][0]],
+					&staticBody.vertices[staticBody.getFaces()[i][1]],
+					&staticBody.vertices[staticBody.getFaces()[i][2]]};
+
+				return (partialCollisionContext =
+					nut::doesCollide(this->shape, this->getObjectMatrix(), corners));
+			});
+
+		return partialCollisionContext;
+	}
+
+	std::array<ThreeVector<float>, 2>*
+	RigidBody::doesCollide(const Heightfield& heightfield) const
+	{
+		std::array<ThreeVector<float>, 2>* partialCollisionContext = nullptr;
+
+		if (this->shape.type != ShapeType::MESH)
+		{
+			heightfield.visitTriangles(getBounds(this->shape, this->getObjectMatrix()),
+				[&](const ThreeVector<float>(& corners)[3], const ThreeVector<float>&) {
+					const ThreeVector<float>* const cornerPointers[3] = {
+						&corners[0], &corners[1], &corners[2]};
+
+					return (partialCollisionContext =
+						nut::doesCollide(this->shape, this->getObjectMatrix(), cornerPointers));
+				});
+
+			return partialCollisionContext;
+		}
+
+		for (unsigned i = 0; i != this->getTriangleCount(); ++i)
+		{
+			const ThreeVector<float>* const face[3] = {
+				&this->vertices[this->getFaces()[i][0]],
+				&this->vertices[this->getFaces()[i][1]],
+				&this->vertices[this->getFaces()[i][2]]};
+
+			AxisAlignedBox box = getEmptyBox();
+			grow(box, *face[0]);
+			grow(box, *face[1]);
+			grow(box, *face[2]);
+
+			// We take the first hit.
+			if (heightfield.visitTriangles(box, [&](const ThreeVector<float>(& corners)[3],
+					const ThreeVector<float>& surfaceNormal) {
+					const ThreeVector<float>* const faces[2][3] = {
+						{face[0], face[1], face[2]}, {&corners[0], &corners[1], &corners[2]}};
+					const ThreeVector<float>* const surfaceNormals[2] = {
+						&this->surfaceNormals[i], &surfaceNormal};
+
+					return (partialCollisionContext = Body::doesCollide(faces, surfaceNormals));
+				}))
+			{
+				return partialCollisionContext;
+			}
+		}
+		return nullptr;
+	}
+
 	void RigidBody::effectElasticCollision(RigidBody& otherBody,
 		ThreeVector<float>& pointOfCollision, ThreeVector<float>& normal)
 	{
 		// Includes transformation to world coordinates.
 		ThreeVector<float> angularVelocity[2] = {
-			this->modelViewMatrix * static_cast<ThreeVector<float, NORMAL>&&>(
+			this->getObjectMatrix() * static_cast<ThreeVector<float, NORMAL>&&>(
 					this->angularFrequency * this->rotationAxis),
-			otherBody.modelViewMatrix * static_cast<ThreeVector<float, NORMAL>&&>(
+			otherBody.getObjectMatrix() * static_cast<ThreeVector<float, NORMAL>&&>(
 					otherBody.angularFrequency * otherBody.rotationAxis)};
 
 		ThreeVector<float> velocityAddend[2] = {
@@ -81,9 +420,9 @@ namespace nut
 
 		ThreeVector<float> angularVelocityAddend[2] = {
 			getCrossProduct(pointOfCollision -
-				ThreeVector<float>(this->modelViewMatrix + 12), normal),
+				ThreeVector<float>(this->getObjectMatrix() + 12), normal),
 			- getCrossProduct(pointOfCollision -
-				ThreeVector<float>(otherBody.modelViewMatrix + 12), normal)};
+				ThreeVector<float>(otherBody.getObjectMatrix() + 12), normal)};
 
 		angularVelocityAddend[0][0] /= this->momentOfInertia[0];
 		angularVelocityAddend[0][1] /= this->momentOfInertia[1];
@@ -95,15 +434,15 @@ namespace nut
 
 		float commonFactor = -2.f * (this->velocity * normal - otherBody.velocity * normal +
 				angularVelocity[0] * getCrossProduct(pointOfCollision -
-					ThreeVector<float>(this->modelViewMatrix + 12), normal) -
+					ThreeVector<float>(this->getObjectMatrix() + 12), normal) -
 				angularVelocity[1] * getCrossProduct(pointOfCollision -
-					ThreeVector<float>(otherBody.modelViewMatrix + 12), normal)) /
+					ThreeVector<float>(otherBody.getObjectMatrix() + 12), normal)) /
 			(normal * velocityAddend[0] - normal * velocityAddend[1] +
 				getCrossProduct(pointOfCollision -
-					ThreeVector<float>(this->modelViewMatrix + 12), normal) *
+					ThreeVector<float>(this->getObjectMatrix() + 12), normal) *
 				angularVelocityAddend[0] -
 				getCrossProduct(pointOfCollision -
-					ThreeVector<float>(otherBody.modelViewMatrix + 12), normal) *
+					ThreeVector<float>(otherBody.getObjectMatrix() + 12), normal) *
 				angularVelocityAddend[1]);
 
 		angularVelocity[0] += commonFactor * angularVelocityAddend[0];
@@ -111,7 +450,7 @@ namespace nut
 
 		// Tranform back to object coordinates.
 		static_cast<ThreeVector<float, NORMAL>&>(angularVelocity[0]).multiplyByInverse(
-			this->modelViewMatrix);
+			this->getObjectMatrix());
 
 		this->velocity += commonFactor * velocityAddend[0];
 
@@ -125,6 +464,52 @@ namespace nut
 		if (otherBody.angularFrequency != .0f)
 			otherBody.rotationAxis = angularVelocity[1] / otherBody.angularFrequency;
 	}
+
+	void RigidBody::effectElasticCollision(ThreeVector<float>& pointOfCollision,
+		ThreeVector<float>& normal)
+	{
+		// The above with the other body's mass and moments of inertia being infinite.
+		ThreeVector<float> angularVelocity(this->getObjectMatrix() *
+			static_cast<ThreeVector<float, NORMAL>&&>(
+				this->angularFrequency * this->rotationAxis));
+
+		ThreeVector<float> leverArm(pointOfCollision -
+			ThreeVector<float>(this->getObjectMatrix() + 12));
+
+		// Let the normal point away from the obstacle (towards the center of this body) and
+		// leave bodies alone that are already on their way out of it.  Otherwise a contact
+		// that is still found in the next step would push the body back in.
+		if (normal * leverArm > .0f)
+			normal = -normal;
+
+		if ((this->velocity + getCrossProduct(angularVelocity, leverArm)) * normal >= .0f)
+			return;
+
+		ThreeVector<float> velocityAddend(normal / this->mass);
+
+		ThreeVector<float> torque(getCrossProduct(leverArm, normal));
+
+		ThreeVector<float> angularVelocityAddend(torque);
+
+		angularVelocityAddend[0] /= this->momentOfInertia[0];
+		angularVelocityAddend[1] /= this->momentOfInertia[1];
+		angularVelocityAddend[2] /= this->momentOfInertia[2];
+
+		float commonFactor = -2.f * (this->velocity * normal + angularVelocity * torque) /
+			(normal * velocityAddend + torque * angularVelocityAddend);
+
+		angularVelocity += commonFactor * angularVelocityAddend;
+
+		// Tranform back to object coordinates.
+		static_cast<ThreeVector<float, NORMAL>&>(angularVelocity).multiplyByInverse(
+			this->getObjectMatrix());
+
+		this->velocity += commonFactor * velocityAddend;
+
+		this->angularFrequency = angularVelocity.getNorm();
+		if (this->angularFrequency != .0f)
+			this->rotationAxis = angularVelocity / this->angularFrequency;
+	}
 }
 
 // vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <array>
+#include <chrono>
 #include <cmath>
 #include <cstddef> // std::size_t
 #include <memory>
@@ -26,12 +27,19 @@
 #include <vector>
 
 #include "body.hpp"
+#include "contact.hpp"
 #include "modelViewMatrix.hpp"
+#include "shape.hpp"
 #include "threeVector.hpp"
+#include "transformArray.hpp"
 
 namespace nut
 {
+	class Heightfield;
+	class QuantizedPool;
 	class RigidBody;
+	class StaticBody;
+	struct CollisionLevel;
 
 	typedef std::tuple<float, RigidBody*, RigidBody*, std::array<ThreeVector<float>, 2>*>
 		 CollisionContext;
@@ -50,46 +58,356 @@ namespace nut
 			float angularFrequency, const ThreeVector<float>& rotationAxis,
 			const Body::Pool&, const RigidBody::Pool&);
 
-		~RigidBody() = default;
+		// A body that collides as a primitive shape rather than by triangles.
+		RigidBody(float mass, const float(& momentOfInertia)[3],
+			const ModelViewMatrix<float>& modelViewMatrix,
+			const ThreeVector<float>& velocity,
+			float angularFrequency, const ThreeVector<float>& rotationAxis, const Shape&);
+
+		// A mesh of compressed pools, decoded as the body is transformed.  getVertex() and
+		// getSurfaceNormal() return nullptr for it; the QuantizedPool, which has to outlive
+		// the body, decodes them.
+		RigidBody(float mass, const float(& momentOfInertia)[3],
+			const ModelViewMatrix<float>& modelViewMatrix,
+			const ThreeVector<float>& velocity,
+			float angularFrequency, const ThreeVector<float>& rotationAxis,
+			const QuantizedPool&);
+
+		// A mesh that collides as one of several levels of detail, e.g. its full mesh, a
+		// simplified one and its convex hull, ordered from finest to coarsest.  Each step it
+		// takes the coarsest one whose deviation is acceptable; see lodDistanceRatio.  There
+		// has to be at least one, and the levels have to outlive the body.
+		RigidBody(float mass, const float(& momentOfInertia)[3],
+			const ModelViewMatrix<float>& modelViewMatrix,
+			const ThreeVector<float>& velocity,
+			float angularFrequency, const ThreeVector<float>& rotationAxis,
+			const std::vector<CollisionLevel>&);
+
+		~RigidBody();
 
 		RigidBody& operator=(const RigidBody&) = delete;
 
 		friend void advanceState(); // For constant framerates.
 
+		friend void advanceState(float elapsedTime);
+
 		friend void shiftState(float timeInterval);
 
+		// The body's entry of the TransformArray.
 		ModelViewMatrix<float>& getObjectMatrix();
+		const ModelViewMatrix<float>& getObjectMatrix() const;
+
+		std::size_t getTransformIndex() const { return this->transformIndex; }
+
+		// The object matrix before the last step.
+		const ModelViewMatrix<float>& getPreviousObjectMatrix() const {
+			return this->previousModelViewMatrix;
+		}
 
 		ThreeVector<float>& getVelocity() { return this->velocity; }
+		const ThreeVector<float>& getVelocity() const { return this->velocity; }
+
+		float getAngularFrequency() const { return this->angularFrequency; }
+
+		// in object coordinates
+		const ThreeVector<float>& getRotationAxis() const { return this->rotationAxis; }
+
+		float getMass() const { return this->mass; }
+
+		const float (& getMomentOfInertia() const)[3] { return this->momentOfInertia; }
+
+		const Shape& getShape() const { return this->shape; }
+
+		// of a sphere around the origin of object coordinates
+		float getBoundingRadius() const { return this->boundingRadius; }
+
+		CollisionFilter& getCollisionFilter() { return this->collisionFilter; }
+		const CollisionFilter& getCollisionFilter() const { return this->collisionFilter; }
+
+		// The level of detail the body collides as, 0 for bodies with only one.
+		unsigned getCollisionLevel() const { return this->collisionLevel; }
+
+		// The global coordinates of a mesh, as of the last transform.
+		const ThreeVector<float>* getVertices() const { return this->vertices; }
+
+		const ThreeVector<float>* getSurfaceNormals() const { return this->surfaceNormals; }
+
+		using Body::getFaces;
+		using Body::getTriangleCount;
+
+		// What a step changes about a body; see WorldState.
+		struct State
+		{
+			ModelViewMatrix<float> modelViewMatrix;
+			ModelViewMatrix<float> previousModelViewMatrix;
+			ThreeVector<float> velocity;
+			ThreeVector<float> rotationAxis;
+			float angularFrequency;
+			unsigned collisionLevel;
+		};
+
+		State getState() const;
+
+		// Put the body into the state and transform it.  Impacts predicted before are void.
+		void setState(const State&);
+
+		// The narrow phase outside of a step, e.g. for queries and tests: the point and
+		// normal of a collision, which the caller owns, or nullptr if the bodies don't
+		// collide.  Dispatches on the shapes of both bodies.
+		std::array<ThreeVector<float>, 2>* doesCollide(const RigidBody&) const;
+
+		// Same as above for two meshes, but only tests the triangles of the other body that
+		// the tree puts near those of this one.  The tree has to be built over the other
+		// body's global vertices.
+		std::array<ThreeVector<float>, 2>* doesCollide(const RigidBody&,
+			const TriangleTree&) const;
+
+		// Whether the body overlaps a primitive placed by the matrix.
+		bool doesOverlap(const Shape&, const ModelViewMatrix<float>&) const;
+
+		// All rigid bodies, in the order steps test them in.
+		static const std::vector<RigidBody*>& getBodies() { return RigidBody::rigidBodies; }
+
+		// The contacts of the last step, against which the next one reports its events.
+		// Setting them drops those of a step that was taken in pieces and isn't done.
+		static const std::vector<ContactEvent>& getLastContacts() {
+			return RigidBody::lastContacts;
+		}
+
+		static void setLastContacts(const std::vector<ContactEvent>&);
 
 		protected:
 
 		ThreeVector<float>* getVertex() const {
-			return std::get<0>(this->pool);
+			return std::get<0>(*this->pool);
 		}
 
 		ThreeVector<float>* getSurfaceNormal() const {
-			return std::get<1>(this->pool);
+			return std::get<1>(*this->pool);
 		}
 
 		unsigned getVertexCount() const {
-			return std::get<2>(this->pool);
+			return std::get<2>(*this->pool);
 		}
 
 		// data shared by a group of objects of nut::RigidBody
-		const Pool& pool;
-
-		ModelViewMatrix<float> modelViewMatrix;
+		const Pool* pool;
 
 		private:
 
+		// Transformation and narrow phase of a body whose pools have a size known at compile
+		// time; see FixedRigidBody.
+		struct Kernels
+		{
+			void (*transform)(RigidBody&);
+
+			// Like doesCollide(const RigidBody&) for two meshes, the first of that size.
+			std::array<ThreeVector<float>, 2>* (*doesCollideWithMesh)(const RigidBody&,
+				const RigidBody&);
+
+			// Like doesCollide(const Shape&, const ModelViewMatrix<float>&).
+			std::array<ThreeVector<float>, 2>* (*doesCollideWithShape)(const RigidBody&,
+				const Shape&, const ModelViewMatrix<float>&);
+		};
+
+		// A mesh body that keeps the global coordinates of its vertices and surface normals
+		// itself, in the space given, rather than in the GeometryArena, and uses the kernels
+		// instead of the loops over its pools.  The kernels only fit pools of their size, so
+		// such a body can neither have compressed pools nor levels of detail.
+		RigidBody(float mass, const float(& momentOfInertia)[3],
+			const ModelViewMatrix<float>& modelViewMatrix,
+			const ThreeVector<float>& velocity,
+			float angularFrequency, const ThreeVector<float>& rotationAxis,
+			const Body::Pool&, const RigidBody::Pool&, ThreeVector<float> vertices[],
+			ThreeVector<float> surfaceNormals[], const Kernels&);
+
+		const Kernels* kernels = nullptr; // for bodies of any size
+
 		void move(float timeInterval = 1.f);
 
-		static void advanceState();
+		// Transform the pool's vertices and surface normals to global coordinates.
+		void transform();
+
+		// Advance by one step of the given length, split into as many substeps as the
+		// fastest body needs.
+		static void advanceState(float timeInterval);
+
+		struct Progress;
+
+		// Continue the step until it's done or the deadline has passed, whichever comes
+		// first, and at least by one piece of work; returns whether it's done.
+		static bool advance(Progress&, std::chrono::steady_clock::time_point deadline);
+
+		// Number of substeps for a step of the given length, between 1 and maxSubsteps.
+		static unsigned short getSubstepCount(float timeInterval);
+
+		// Move all bodies by timeInterval and resolve impacts in the order they happen,
+		// predicting new ones for the bodies involved only; see eventDriven.  Not split into
+		// pieces.
+		static void advanceEvents(float timeInterval);
+
+		struct Impact;
+
+		// What mayCollide reads of a body, so the all-pairs test of a substep runs over
+		// contiguous memory in the order of rigidBodies.
+		struct Reach
+		{
+			explicit Reach(const RigidBody& body) : center(body.getObjectMatrix() + 12),
+				radius{body.boundingRadius}, collisionFilter(body.collisionFilter) {}
+
+			// same as RigidBody::mayCollide
+			bool mayCollide(const Reach& other) const
+			{
+				if (!doCollide(this->collisionFilter, other.collisionFilter))
+					return false;
+
+				ThreeVector<float> offset(this->center - other.center);
+				float reach = this->radius + other.radius;
+
+				return offset * offset <= reach * reach;
+			}
+
+			ThreeVector<float> center;
+			float radius;
+			CollisionFilter collisionFilter;
+		};
+
+		// Queue the first impact of the body on the obstacle after begin (a fraction of the
+		// substep), if there is one.  otherBody is the obstacle if that is a rigid body and
+		// nullptr otherwise.  Both bodies are at the end of the substep, and are put back
+		// there.
+		template <typename Obstacle>
+		static void predictImpact(RigidBody& body, const Obstacle&, RigidBody* otherBody,
+			float begin, float timeInterval, std::vector<Impact>& impacts);
 
 		static void shiftState(float timeInterval);
 
-		friend void refine(CollisionContext& collisionContext);
+		// Bisections of a range of timeInterval that pin down when the body hit the obstacle
+		// precisely enough: those that leave at most refineTolerance times the smaller
+		// bounding radius for the bodies to travel relative to each other, at least 1 and at
+		// most refineIterations.  Takes them from the budget of the step, which may cut them
+		// down to minRefineIterations; otherBody is the obstacle if that is a rigid body and
+		// nullptr otherwise.
+		static unsigned short getRefineIterations(const RigidBody& body,
+			const RigidBody* otherBody, float timeInterval);
+
+		// refineBudget, less the bisections spent in the current step
+		static unsigned refineBudgetLeft;
+
+		// Switch to the coarsest level of detail whose deviation is acceptable for a step of
+		// the given length.
+		void selectCollisionLevel(float timeInterval);
+
+		// Collide as the given level of detail from the next transform on.
+		void useCollisionLevel(unsigned level);
+
+		template <typename Obstacle>
+		friend void refine(CollisionContext&, const Obstacle&, float timeInterval);
+
+		friend class DeformableBody;
+		template <unsigned vertexCount, unsigned triangleCount>
+		friend class FixedRigidBody;
+		friend class Heightfield;
+		friend class Partition;
+		friend class StaticBody;
+		friend class SlicedStep;
+		friend class Stepper;
+
+		using Body::doesCollide;
+
+		// Test the triangles of this body, a mesh, against a primitive placed by the matrix.
+		std::array<ThreeVector<float>, 2>* doesCollide(const Shape&,
+			const ModelViewMatrix<float>&) const;
+
+		// Test against the triangles of the static body close to those of this one.
+		std::array<ThreeVector<float>, 2>* doesCollide(const StaticBody&) const;
+
+		// Test against the triangles of the cells under those of this body.
+		std::array<ThreeVector<float>, 2>* doesCollide(const Heightfield&) const;
+
+		// Whether the collision filters let the bodies collide and their bounding spheres
+		// touch; cheap tests to skip the ones above.
+		bool mayCollide(const RigidBody&) const;
+
+		// Whether the collision filters let the body collide with the obstacle.
+		bool mayCollide(const StaticBody&) const;
+		bool mayCollide(const Heightfield&) const;
+
+		// Test the body against every obstacle, which doesn't move, and add the refined
+		// contexts of all collisions.
+		template <typename Obstacle>
+		static void detectCollisions(RigidBody&, const std::vector<Obstacle*>& obstacles,
+			std::vector<CollisionContext>&, float timeInterval);
+
+		// Remember a collision for the contact events of the step.  contact names the bodies
+		// only.
+		static void recordContact(ContactEvent contact,
+			const std::array<ThreeVector<float>, 2>& partialCollisionContext);
+
+		// Compare the contacts of the step to those of the step before and push the
+		// resulting events to contactEvents.
+		static void reportContacts();
+
+		// Drop the contacts of a body that's destroyed; it gets no END events.
+		static void forgetContacts(const void* body);
+
+		// How far a step has got, so it can be taken in pieces.
+		struct Progress
+		{
+			enum class Stage : unsigned char
+			{
+				BEGIN, // levels of detail and the number of substeps
+				MOVE, // all bodies at once
+				PAIRS, // one row of pairs, or up to a collision
+				OBSTACLES, // one body against all static bodies and heightfields
+				RESPONSE, // one collision
+				DEFORM, // all deformable bodies at once
+				END, // dirty bits and contact events
+				DONE
+			};
+
+			Progress() = delete;
+			Progress(const Progress&) = delete;
+
+			explicit Progress(float timeInterval) : timeInterval{timeInterval} {}
+
+			// Frees the contexts of collisions that haven't been responded to.
+			~Progress();
+
+			Progress& operator=(const Progress&) = delete;
+
+			const float timeInterval; // of the step
+			Stage stage = Stage::BEGIN;
+			unsigned short substepCount = 0u;
+			unsigned short substep = 0u;
+			std::size_t i = 0u; // where the stage stopped
+			std::size_t j = 0u;
+			std::vector<Reach> reaches;
+			std::vector<CollisionContext> collisionContexts;
+		};
+
+		// of the current step and of the one before, each pair once
+		static std::vector<ContactEvent> contacts;
+		static std::vector<ContactEvent> lastContacts;
+
+		Shape shape;
+
+		const QuantizedPool* quantizedPool = nullptr; // if the pools are compressed
+
+		const std::vector<CollisionLevel>* collisionLevels = nullptr; // if there are several
+		unsigned collisionLevel = 0u;
+
+		CollisionFilter collisionFilter;
+
+		std::size_t transformIndex;
+
+		ModelViewMatrix<float> previousModelViewMatrix;
+
+		float boundingRadius; // around the origin of object coordinates
+
+		// Counts changes of course, so impacts predicted before one can be told apart.
+		unsigned generation = 0u;
+		unsigned short impactCount = 0u; // in the current substep
 
 		float mass;
 		float momentOfInertia[3];
@@ -98,106 +416,148 @@ namespace nut
 		ThreeVector<float> rotationAxis; // in object coordinates
 
 		static std::vector<RigidBody*> rigidBodies;
+		static unsigned long bodyChangeCount; // rigid bodies created and destroyed
 
 		void effectElasticCollision(RigidBody&, ThreeVector<float>& pointOfCollision,
 			ThreeVector<float>& normal);
+
+		// Collision with something that doesn't move, e.g. a StaticBody.
+		void effectElasticCollision(ThreeVector<float>& pointOfCollision,
+			ThreeVector<float>& normal);
+	};
+
+	// One of the pools a mesh may collide as.  deviation bounds how far any point of its
+	// surface is from the surface of the finest level; see CollisionProxy.
+	struct CollisionLevel
+	{
+		const Body::Pool* bodyPool;
+		const RigidBody::Pool* rigidBodyPool;
+		float deviation;
 	};
 
 	void advanceState();
 
+	// Advance by elapsedTime in steps of fixedTimeStep.  Time left over is carried to the
+	// next call.
+	void advanceState(float elapsedTime);
+
+	// Time carried over by advanceState(float) as a fraction of fixedTimeStep.  Renderers
+	// blend from getPreviousObjectMatrix() to getObjectMatrix() by it.
+	float getInterpolationAlpha();
+
+	// The time carried over by advanceState(float) itself, e.g. to save it with the
+	// bodies.
+	float getCarriedTime();
+	void setCarriedTime(float);
+
 	void shiftState(float timeInterval);
 
 	void refine(CollisionContext& collisionContext, unsigned char iterations);
 
 	inline ModelViewMatrix<float>& RigidBody::getObjectMatrix() {
-		return this->modelViewMatrix;
+		return TransformArray::matrices[this->transformIndex];
+	}
+
+	inline const ModelViewMatrix<float>& RigidBody::getObjectMatrix() const {
+		return TransformArray::matrices[this->transformIndex];
 	}
 
+	// Bisections per collision at most; each halves the uncertainty of its time.
 	extern unsigned short refineIterations;
 
-	inline void refine(CollisionContext& collisionContext)
+	// Distance the bodies of a collision may travel relative to each other within the
+	// uncertainty of its time, relative to the smaller bounding radius.
+	extern float refineTolerance;
+
+	// Bisections of all collisions per step at most, 0 for no limit.  Once they're spent,
+	// collisions get minRefineIterations each, or fewer if that is precise enough.
+	extern unsigned refineBudget;
+	extern unsigned short minRefineIterations;
+
+	// Levels of detail of bodies that have several: a level is acceptable while its
+	// deviation is at most lodDistanceRatio times the distance of the body from the
+	// nearest of collisionFoci, e.g. the camera, or lodTravelRatio times the distance a
+	// point of the body travels in the step.  A ratio of 0 turns either test off.
+	extern std::vector<ThreeVector<float>> collisionFoci;
+	extern float lodDistanceRatio;
+	extern float lodTravelRatio;
+
+	// Length of a step of advanceState(float).
+	extern float fixedTimeStep;
+
+	// Steps taken by a call of advanceState(float) at most; elapsed time beyond them is
+	// dropped rather than making the next call take even longer.
+	extern unsigned short maxSteps;
+
+	// Substeps per step at most.
+	extern unsigned short maxSubsteps;
+
+	// Distance bodies may travel per substep, relative to their bounding radius.
+	extern float maxTravel;
+
+	// Whether substeps resolve impacts one after another in the order they happen, each
+	// with the bodies at its time, and look for follow-up impacts.  Otherwise all impacts
+	// found at the end of a substep are resolved at once.
+	extern bool eventDriven;
+
+	// Impacts per body and substep at most in event-driven mode.
+	extern unsigned short maxImpacts;
+
+	// Bisect the last time step to move the bodies of the context back to about the time of
+	// their first contact, updating the context on the way.  The second body of the context
+	// is nullptr if the first one hit an obstacle that doesn't move; otherwise the obstacle
+	// is that second body.  The step was timeInterval long; the time of the context is a
+	// fraction of it.
+	template <typename Obstacle>
+	void refine(CollisionContext& collisionContext, const Obstacle& obstacle,
+		float timeInterval)
 	{
-		std::get<1>(collisionContext)->move(-.5f);
-		std::get<2>(collisionContext)->move(-.5f);
+		auto move = [&collisionContext, timeInterval](float fraction) {
+			std::get<1>(collisionContext)->move(fraction * timeInterval);
+			if (std::get<2>(collisionContext))
+				std::get<2>(collisionContext)->move(fraction * timeInterval);
+		};
+
+		const unsigned short iterations = RigidBody::getRefineIterations(
+			*std::get<1>(collisionContext), std::get<2>(collisionContext), timeInterval);
+
+		move(-.5f);
 
 		std::size_t i = 1u;
 
-		while (i < refineIterations)
+		while (i < iterations)
 		{
 			++i;
 
-			auto newContext =
-				std::get<1>(collisionContext)->doesCollide(*std::get<2>(collisionContext));
+			auto newContext = std::get<1>(collisionContext)->doesCollide(obstacle);
 
 			if (newContext)
 			{
 				// test
+				delete std::get<3>(collisionContext);
 				std::get<3>(collisionContext) = newContext;
 					//std::get<1>(collisionContext)->doesCollide(*std::get<2>(collisionContext));
 				// test
-				std::get<1>(collisionContext)->move(-1.f / std::pow(2, i));
-				std::get<2>(collisionContext)->move(-1.f / std::pow(2, i));
+				move(-1.f / std::pow(2, i));
 			}
 			else
 			{
-				std::get<1>(collisionContext)->move(1.f / std::pow(2, i));
-				std::get<2>(collisionContext)->move(1.f / std::pow(2, i));
+				move(1.f / std::pow(2, i));
 
 				std::get<0>(collisionContext) -= 1.f / std::pow(2, i - 1);
 			}
 		}
 
-		if (std::get<1>(collisionContext)->doesCollide(*std::get<2>(collisionContext)))
+		if (auto overlap = std::get<1>(collisionContext)->doesCollide(obstacle))
 		{
-			std::get<1>(collisionContext)->move(-1.f / std::pow(2, i));
-			std::get<2>(collisionContext)->move(-1.f / std::pow(2, i));
+			delete overlap;
+			move(-1.f / std::pow(2, i));
 		}
 		else
 		{
 			std::get<0>(collisionContext) -= 1.f / std::pow(2, i);
 	  }
 	}
-
-	inline void RigidBody::advanceState()
-	{
-		// update rigid bodies
-		for (auto i : RigidBody::rigidBodies) i->move();
-
-		std::vector<CollisionContext> collisionContexts;
-
-		// a posteriori collision check
-		for (auto i = RigidBody::rigidBodies.begin(); i != RigidBody::rigidBodies.end(); ++i)
-		{
-			auto j = i; ++j;
-			for (; j != RigidBody::rigidBodies.end(); ++j)
-			{
-				if (auto partialCollisionContext = (*i)->doesCollide(**j))
-				{
-					collisionContexts.push_back(
-						std::make_tuple(1.f, *i, *j, partialCollisionContext));
-
-					refine(collisionContexts.back());
-				}
-			}
-		}
-
-		std::sort(collisionContexts.begin(), collisionContexts.end(),
-			[](const CollisionContext& a, const CollisionContext& b) {
-				return std::get<0>(a) < std::get<0>(b);
-			}
-		);
-
-		for (const auto& i : collisionContexts)
-		{
-			std::get<1>(i)->effectElasticCollision(*std::get<2>(i), (*std::get<3>(i))[0],
-					(*std::get<3>(i))[1]);
-
-			std::get<1>(i)->move(std::get<0>(i));
-			std::get<2>(i)->move(std::get<0>(i));
-
-			// TODO: check for follow-up collisions.
-		}
-	}
 }
 
 #endif //RIGIDBODY_HPP_SEEN
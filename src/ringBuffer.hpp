@@ -0,0 +1,98 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RINGBUFFER_HPP_SEEN
+#define RINGBUFFER_HPP_SEEN
+
+#include <atomic>
+#include <cstddef> // std::size_t
+#include <vector>
+
+namespace nut
+{
+	// Queue of fixed capacity between one thread that pushes and one that drains, e.g. the
+	// simulation and the game logic; neither of them ever waits for the other.  Values
+	// pushed while it's full are dropped and counted.
+	template <typename T>
+	class RingBuffer
+	{
+		public:
+
+		RingBuffer() = delete;
+		RingBuffer(const RingBuffer&) = delete;
+		explicit RingBuffer(std::size_t capacity) : slots(capacity + 1u) {}
+
+		~RingBuffer() = default;
+
+		RingBuffer& operator=(const RingBuffer&) = delete;
+
+		// Returns false if the value was dropped.
+		bool push(const T& value);
+
+		// Move up to count of the oldest values to values; returns how many there were.
+		std::size_t drain(T values[], std::size_t count);
+
+		std::size_t getDroppedCount() const { return this->droppedCount.load(); }
+
+		private:
+
+		std::size_t getNext(std::size_t slot) const {
+			return slot + 1u == this->slots.size() ? 0u : slot + 1u;
+		}
+
+		// One slot always stays empty to tell a full buffer from an empty one.
+		std::vector<T> slots;
+
+		std::atomic<std::size_t> head{0u}; // slot of the oldest value
+		std::atomic<std::size_t> tail{0u}; // slot to push to
+		std::atomic<std::size_t> droppedCount{0u};
+	};
+
+	template <typename T>
+	bool RingBuffer<T>::push(const T& value)
+	{
+		std::size_t tail = this->tail.load(std::memory_order_relaxed);
+		std::size_t next = this->getNext(tail);
+
+		if (next == this->head.load(std::memory_order_acquire))
+		{
+			this->droppedCount.fetch_add(1u, std::memory_order_relaxed);
+			return false;
+		}
+
+		this->slots[tail] = value;
+		this->tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	template <typename T>
+	std::size_t RingBuffer<T>::drain(T values[], std::size_t count)
+	{
+		std::size_t head = this->head.load(std::memory_order_relaxed);
+		std::size_t tail = this->tail.load(std::memory_order_acquire);
+		std::size_t drained = 0u;
+
+		for (; drained != count && head != tail; ++drained, head = this->getNext(head))
+			values[drained] = this->slots[head];
+
+		this->head.store(head, std::memory_order_release);
+		return drained;
+	}
+}
+
+#endif //RINGBUFFER_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,235 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "deformableBody.hpp"
+#include "heightfield.hpp"
+#include "parallel.hpp"
+#include "rigidBody.hpp"
+#include "sceneQuery.hpp"
+#include "staticBody.hpp"
+
+namespace nut
+{
+	unsigned queryThreadCount = 0u;
+
+	namespace
+	{
+		// Queries per thread at least; below that, starting the thread takes longer than the
+		// work.
+		const unsigned minimumShare = 256u;
+
+		std::vector<AxisAlignedBox> getBoxes(const std::vector<RigidBody*>& bodies)
+		{
+			std::vector<AxisAlignedBox> boxes;
+			boxes.reserve(bodies.size());
+
+			for (auto i : bodies)
+				boxes.push_back(SceneQuery::getBounds(*i));
+
+			return boxes;
+		}
+
+		void forget(RayHit& hit)
+		{
+			hit.rigidBody = nullptr;
+			hit.staticBody = nullptr;
+			hit.heightfield = nullptr;
+			hit.deformableBody = nullptr;
+		}
+
+		// Test the ray against a triangle of a mesh and record a hit.
+		template <typename Mesh>
+		void castRayAtTriangle(const Ray& ray, const Mesh& mesh, unsigned triangle,
+			const unsigned (* faces)[3], const ThreeVector<float> vertices[],
+			const ThreeVector<float> surfaceNormals[], RayHit& hit,
+			const Mesh* RayHit::* member)
+		{
+			const unsigned (& face)[3] = faces[triangle];
+			const ThreeVector<float>* const corners[3] = {
+				&vertices[face[0]], &vertices[face[1]], &vertices[face[2]]};
+
+			if (nut::castRay(corners, ray.origin, ray.direction, hit.distance))
+			{
+				forget(hit);
+				hit.*member = &mesh;
+				hit.normal = surfaceNormals[triangle];
+			}
+		}
+	}
+
+	AxisAlignedBox SceneQuery::getBounds(const RigidBody& body)
+	{
+		if (body.getShape().type != ShapeType::MESH)
+			return nut::getBounds(body.getShape(), body.getObjectMatrix());
+
+		const float* center = &body.getObjectMatrix()[12];
+		float radius = body.getBoundingRadius();
+		return AxisAlignedBox{
+			{center[0] - radius, center[1] - radius, center[2] - radius},
+			{center[0] + radius, center[1] + radius, center[2] + radius}};
+	}
+
+	SceneQuery::SceneQuery() :
+		rigidBodies(RigidBody::getBodies().begin(), RigidBody::getBodies().end()),
+		tree{getBoxes(RigidBody::getBodies())} {}
+
+	void SceneQuery::castRays(const Ray rays[], std::size_t count, RayHit hits[]) const
+	{
+		SceneQuery::split(count, [&](std::size_t begin, std::size_t end) {
+			for (std::size_t i = begin; i != end; ++i)
+				this->castRay(rays[i], hits[i]);
+		});
+	}
+
+	void SceneQuery::findOverlaps(const Volume volumes[], std::size_t count,
+		const RigidBody* bodies[], unsigned maxBodies, unsigned bodyCounts[]) const
+	{
+		SceneQuery::split(count, [&](std::size_t begin, std::size_t end) {
+			for (std::size_t i = begin; i != end; ++i)
+				bodyCounts[i] = this->findOverlaps(volumes[i], bodies + i * maxBodies, maxBodies);
+		});
+	}
+
+	void SceneQuery::castRay(const Ray& ray, RayHit& hit) const
+	{
+		forget(hit);
+		hit.distance = ray.length;
+
+		const float inverseDirection[3] = {
+			1.f / ray.direction[0], 1.f / ray.direction[1], 1.f / ray.direction[2]};
+
+		this->tree.visitRay(ray.origin, inverseDirection, hit.distance, [&](unsigned i) {
+			const RigidBody& body = *this->rigidBodies[i];
+
+			if (body.getShape().type != ShapeType::MESH)
+			{
+				if (nut::castRay(body.getShape(), body.getObjectMatrix(), ray.origin,
+					ray.direction, hit.distance, hit.normal))
+				{
+					forget(hit);
+					hit.rigidBody = &body;
+				}
+			}
+			else
+			{
+				for (unsigned j = 0u; j != body.getTriangleCount(); ++j)
+				{
+					castRayAtTriangle(ray, body, j, body.getFaces(), body.getVertices(),
+						body.getSurfaceNormals(), hit, &RayHit::rigidBody);
+				}
+			}
+
+			return hit.distance;
+		});
+
+		for (auto i : StaticBody::staticBodies)
+		{
+			i->tree.visitRay(ray.origin, inverseDirection, hit.distance, [&](unsigned j) {
+				castRayAtTriangle(ray, *i, j, i->getFaces(), i->vertices,
+					i->surfaceNormals, hit, &RayHit::staticBody);
+				return hit.distance;
+			});
+		}
+
+		for (auto i : DeformableBody::deformableBodies)
+		{
+			i->tree.visitRay(ray.origin, inverseDirection, hit.distance, [&](unsigned j) {
+				castRayAtTriangle(ray, *i, j, i->getFaces(), i->vertices,
+					i->surfaceNormals, hit, &RayHit::deformableBody);
+				return hit.distance;
+			});
+		}
+
+		// Walk heightfields a cell long piece of the ray at a time; the first hit in a piece
+		// is the first one at all.
+		for (auto i : Heightfield::heightfields)
+		{
+			float range[2] = {.0f, hit.distance};
+			if (!clipRay(i->bounds, ray.origin, inverseDirection, range))
+				continue;
+
+			for (float begin = range[0]; begin < std::min(range[1], hit.distance);
+				begin += i->spacing)
+			{
+				float end = std::min(begin + i->spacing, range[1]);
+				ThreeVector<float> ends[2] = {
+					ray.origin + begin * ray.direction, ray.origin + end * ray.direction};
+
+				AxisAlignedBox box = getEmptyBox();
+				grow(box, ends[0]);
+				grow(box, ends[1]);
+
+				i->visitTriangles(box, [&](const ThreeVector<float> (& triangle)[3],
+					const ThreeVector<float>& surfaceNormal) {
+						const ThreeVector<float>* const corners[3] = {
+							&triangle[0], &triangle[1], &triangle[2]};
+
+						if (nut::castRay(corners, ray.origin, ray.direction, hit.distance))
+						{
+							forget(hit);
+							hit.heightfield = i;
+							hit.normal = surfaceNormal;
+						}
+
+						return false;
+					});
+
+				if (hit.heightfield == i && hit.distance <= end)
+					break;
+			}
+		}
+	}
+
+	unsigned SceneQuery::findOverlaps(const Volume& volume, const RigidBody* bodies[],
+		unsigned maxBodies) const
+	{
+		unsigned bodyCount = 0u;
+
+		if (maxBodies == 0u)
+			return 0u;
+
+		this->tree.visitOverlaps(nut::getBounds(volume.shape, volume.modelViewMatrix),
+			[&](unsigned i) {
+				const RigidBody& body = *this->rigidBodies[i];
+
+				if (body.doesOverlap(volume.shape, volume.modelViewMatrix))
+					bodies[bodyCount++] = &body;
+
+				return bodyCount == maxBodies;
+			});
+
+		return bodyCount;
+	}
+
+	template <typename Function>
+	void SceneQuery::split(std::size_t count, Function function)
+	{
+		unsigned threadCount = queryThreadCount ? queryThreadCount :
+			std::max(std::thread::hardware_concurrency(), 1u);
+		threadCount = static_cast<unsigned>(
+			std::min<std::size_t>(threadCount, count / minimumShare + 1u));
+
+		runInParallel(threadCount, [&](unsigned i) {
+			function(count * i / threadCount, count * (i + 1u) / threadCount);
+		});
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
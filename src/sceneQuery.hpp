@@ -0,0 +1,113 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCENEQUERY_HPP_SEEN
+#define SCENEQUERY_HPP_SEEN
+
+#include <cstddef> // std::size_t
+#include <vector>
+
+#include "boxTree.hpp"
+#include "shape.hpp"
+#include "threeVector.hpp" // needs to precede modelViewMatrix.hpp
+#include "modelViewMatrix.hpp"
+
+namespace nut
+{
+	class DeformableBody;
+	class Heightfield;
+	class RigidBody;
+	class StaticBody;
+
+	struct Ray
+	{
+		ThreeVector<float> origin;
+		ThreeVector<float> direction; // a unit vector
+		float length;
+	};
+
+	// What a ray hit first.  At most one of the pointers is set, none if the ray hit
+	// nothing.
+	struct RayHit
+	{
+		const RigidBody* rigidBody;
+		const StaticBody* staticBody;
+		const Heightfield* heightfield;
+		const DeformableBody* deformableBody;
+		float distance; // from the origin of the ray, its length if it hit nothing
+		ThreeVector<float> normal; // of the surface hit
+	};
+
+	// A primitive placed by a matrix that doesn't scale, to find the bodies inside.
+	struct Volume
+	{
+		Shape shape;
+		ModelViewMatrix<float> modelViewMatrix;
+	};
+
+	// Answers batches of queries about all bodies at once, e.g. for line of sight.  Queries
+	// are split between threads.  A tree over the boxes of the rigid bodies finds those
+	// worth testing in detail; static and deformable bodies have trees of their own and
+	// heightfields are walked cell by cell along rays.
+	//
+	// Construct one after a step; it has to be reconstructed after the next one.
+	class SceneQuery
+	{
+		public:
+
+		SceneQuery();
+		SceneQuery(const SceneQuery&) = delete;
+
+		~SceneQuery() = default;
+
+		SceneQuery& operator=(const SceneQuery&) = delete;
+
+		// Find the first hit of each ray.
+		void castRays(const Ray rays[], std::size_t count, RayHit hits[]) const;
+
+		// Find the rigid bodies overlapping each volume, which has to be a primitive.  Those
+		// for volumes[i] are stored from bodies[i * maxBodies] on, and their number in
+		// bodyCounts[i].  Bodies beyond maxBodies are left out.
+		void findOverlaps(const Volume volumes[], std::size_t count,
+			const RigidBody* bodies[], unsigned maxBodies, unsigned bodyCounts[]) const;
+
+		// Box in global coordinates around a rigid body.
+		static AxisAlignedBox getBounds(const RigidBody&);
+
+		private:
+
+		void castRay(const Ray&, RayHit&) const;
+
+		unsigned findOverlaps(const Volume&, const RigidBody* bodies[], unsigned maxBodies)
+			const;
+
+		// Run function(begin, end) over parts of [0, count) on as many threads as are worth
+		// it.
+		template <typename Function>
+		static void split(std::size_t count, Function function);
+
+		std::vector<const RigidBody*> rigidBodies; // by index into the tree
+		const BoxTree tree;
+	};
+
+	// Threads a SceneQuery uses at most, 0 for one per hardware thread.  Small batches use
+	// fewer.
+	extern unsigned queryThreadCount;
+}
+
+#endif //SCENEQUERY_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
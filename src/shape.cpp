@@ -0,0 +1,841 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include "shape.hpp"
+
+namespace nut
+{
+	// See Ericson, section 5.1.5.
+	ThreeVector<float> getClosestPoint(const ThreeVector<float>* const (& corners)[3],
+		const ThreeVector<float>& point)
+	{
+		const ThreeVector<float>& a = *corners[0];
+		const ThreeVector<float>& b = *corners[1];
+		const ThreeVector<float>& c = *corners[2];
+
+		ThreeVector<float> ab(b - a), ac(c - a), ap(point - a);
+		float d1 = ab * ap, d2 = ac * ap;
+		if (d1 <= .0f && d2 <= .0f)
+			return ThreeVector<float>(a);
+
+		ThreeVector<float> bp(point - b);
+		float d3 = ab * bp, d4 = ac * bp;
+		if (d3 >= .0f && d4 <= d3)
+			return ThreeVector<float>(b);
+
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= .0f && d1 >= .0f && d3 <= .0f)
+			return a + d1 / (d1 - d3) * ab;
+
+		ThreeVector<float> cp(point - c);
+		float d5 = ab * cp, d6 = ac * cp;
+		if (d6 >= .0f && d5 <= d6)
+			return ThreeVector<float>(c);
+
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= .0f && d2 >= .0f && d6 <= .0f)
+			return a + d2 / (d2 - d6) * ac;
+
+		float va = d3 * d6 - d5 * d4;
+		if (va <= .0f && d4 - d3 >= .0f && d5 - d6 >= .0f)
+			return b + (d4 - d3) / ((d4 - d3) + (d5 - d6)) * (c - b);
+
+		float denominator = va + vb + vc;
+		return a + vb / denominator * ab + vc / denominator * ac;
+	}
+
+	namespace
+	{
+		typedef std::array<ThreeVector<float>, 2> Contact;
+
+		// A primitive in global coordinates.
+		struct Primitive
+		{
+			Primitive(const Shape& shape, const ModelViewMatrix<float>& matrix) :
+				center{matrix[12], matrix[13], matrix[14]},
+				axes{{matrix[0], matrix[1], matrix[2]}, {matrix[4], matrix[5], matrix[6]},
+				     {matrix[8], matrix[9], matrix[10]}},
+				extents{shape.extents[0], shape.extents[1], shape.extents[2]} {}
+
+			// One end of the axis of a capsule; sign is 1 or -1.
+			ThreeVector<float> getEndPoint(float sign) const {
+				return this->center + sign * this->extents[1] * this->axes[1];
+			}
+
+			// The eight corners of a box.
+			void getCorners(ThreeVector<float> (& corners)[8]) const
+			{
+				for (unsigned i = 0; i != 8u; ++i)
+				{
+					corners[i] = this->center +
+						(i & 1u ? 1.f : -1.f) * this->extents[0] * this->axes[0] +
+						(i & 2u ? 1.f : -1.f) * this->extents[1] * this->axes[1] +
+						(i & 4u ? 1.f : -1.f) * this->extents[2] * this->axes[2];
+				}
+			}
+
+			ThreeVector<float> center;
+			ThreeVector<float> axes[3]; // of object coordinates, i.e. unit vectors
+			float extents[3];
+		};
+
+		float clamp(float value, float min, float max) {
+			return std::min(std::max(value, min), max);
+		}
+
+		// Parameters in [0, 1] of the closest points of the segments from p[i] to q[i]; see
+		// Ericson, Real-Time Collision Detection, section 5.1.9.
+		void getClosestParameters(const ThreeVector<float>* const (& p)[2],
+			const ThreeVector<float>* const (& q)[2], float (& parameters)[2])
+		{
+			ThreeVector<float> direction[2] = {*q[0] - *p[0], *q[1] - *p[1]};
+			ThreeVector<float> offset(*p[0] - *p[1]);
+
+			float lengthSquared[2] = {
+				direction[0] * direction[0], direction[1] * direction[1]};
+			float projection[2] = {direction[0] * offset, direction[1] * offset};
+
+			if (lengthSquared[0] == .0f)
+			{
+				parameters[0] = .0f;
+				parameters[1] = lengthSquared[1] == .0f ? .0f :
+					clamp(projection[1] / lengthSquared[1], .0f, 1.f);
+				return;
+			}
+
+			if (lengthSquared[1] == .0f)
+			{
+				parameters[0] = clamp(-projection[0] / lengthSquared[0], .0f, 1.f);
+				parameters[1] = .0f;
+				return;
+			}
+
+			float cosine = direction[0] * direction[1];
+			float denominator = lengthSquared[0] * lengthSquared[1] - cosine * cosine;
+
+			// Take any point of the first segment if they're parallel.
+			parameters[0] = denominator == .0f ? .0f : clamp((cosine * projection[1] -
+				projection[0] * lengthSquared[1]) / denominator, .0f, 1.f);
+			parameters[1] = (cosine * parameters[0] + projection[1]) / lengthSquared[1];
+
+			if (parameters[1] < .0f)
+			{
+				parameters[1] = .0f;
+				parameters[0] = clamp(-projection[0] / lengthSquared[0], .0f, 1.f);
+			}
+			else if (parameters[1] > 1.f)
+			{
+				parameters[1] = 1.f;
+				parameters[0] = clamp((cosine - projection[0]) / lengthSquared[0], .0f, 1.f);
+			}
+		}
+
+		// Parameter in [0, 1] of the point of the segment from p to q that is closest to a
+		// convex set, given by a function returning the point of the set closest to its
+		// argument.  The distance to a convex set is convex along a segment, so a ternary
+		// search finds its minimum.
+		template <typename ClosestPoint>
+		float getClosestParameter(const ThreeVector<float>& p, const ThreeVector<float>& q,
+			ClosestPoint closestPoint)
+		{
+			auto getDistanceSquared = [&](float parameter) {
+				ThreeVector<float> point(p + parameter * (q - p));
+				ThreeVector<float> difference(point - closestPoint(point));
+				return difference * difference;
+			};
+
+			float range[2] = {.0f, 1.f};
+			for (int i = 0; i != 24; ++i)
+			{
+				float third = (range[1] - range[0]) / 3.f;
+				if (getDistanceSquared(range[0] + third) < getDistanceSquared(range[1] - third))
+					range[1] -= third;
+				else
+					range[0] += third;
+			}
+
+			return (range[0] + range[1]) / 2.f;
+		}
+
+		// Two spheres.  The point of collision is in the middle of the overlap.
+		Contact* collideSpheres(const ThreeVector<float>& center, float radius,
+			const ThreeVector<float>& otherCenter, float otherRadius)
+		{
+			ThreeVector<float> difference(otherCenter - center);
+			float distanceSquared = difference * difference;
+
+			if (distanceSquared > (radius + otherRadius) * (radius + otherRadius))
+				return nullptr;
+
+			float distance = std::sqrt(distanceSquared);
+			ThreeVector<float> normal(distance == .0f ? ThreeVector<float>{.0f, 1.f, .0f} :
+				difference / distance);
+
+			return new Contact{{
+				center + (radius - (radius + otherRadius - distance) / 2.f) * normal,
+				ThreeVector<float>(normal)}};
+		}
+
+		// A sphere and a point of the surface (or the inside) of something closest to its
+		// center.  fallbackNormal is used if the center is on that surface.
+		Contact* collideSphere(const ThreeVector<float>& center, float radius,
+			const ThreeVector<float>& closestPoint, const ThreeVector<float>& fallbackNormal)
+		{
+			ThreeVector<float> difference(center - closestPoint);
+			float distanceSquared = difference * difference;
+
+			if (distanceSquared > radius * radius)
+				return nullptr;
+
+			return new Contact{{ThreeVector<float>(closestPoint), distanceSquared == .0f ?
+				ThreeVector<float>(fallbackNormal) : difference / std::sqrt(distanceSquared)}};
+		}
+
+		// Unit normal of the triangle with the given corners, to fall back on in
+		// collideSphere.  Triangles without area, which importers may leave in, get one
+		// perpendicular to their longest edge instead, or the y axis if they're a point.
+		ThreeVector<float> getFallbackNormal(const ThreeVector<float>* const (& corners)[3])
+		{
+			ThreeVector<float> normal(getCrossProduct(*corners[1] - *corners[0],
+				*corners[2] - *corners[0]));
+
+			if (normal * normal > .0f)
+				return normal.getUnitVector();
+
+			unsigned longest = 0u;
+			float longestSquared = .0f;
+
+			for (unsigned i = 0u; i != 3u; ++i)
+			{
+				ThreeVector<float> edge(*corners[(i + 1u) % 3u] - *corners[i]);
+				if (edge * edge > longestSquared)
+				{
+					longest = i;
+					longestSquared = edge * edge;
+				}
+			}
+
+			ThreeVector<float> edge(*corners[(longest + 1u) % 3u] - *corners[longest]);
+
+			// Of the axes, the edge is the least along this one.
+			unsigned axis = 0u;
+			for (unsigned i = 1u; i != 3u; ++i)
+			{
+				if (std::abs(edge[i]) < std::abs(edge[axis]))
+					axis = i;
+			}
+
+			ThreeVector<float> unit{.0f, .0f, .0f};
+			unit[axis] = 1.f;
+
+			ThreeVector<float> perpendicular(getCrossProduct(edge, unit));
+
+			if (perpendicular * perpendicular > .0f)
+				return perpendicular.getUnitVector();
+
+			return ThreeVector<float>{.0f, 1.f, .0f};
+		}
+
+		// A sphere and a box.  If the center of the sphere is inside the box, the normal is
+		// that of the closest face.
+		Contact* collideSphere(const ThreeVector<float>& center, float radius,
+			const Primitive& box)
+		{
+			ThreeVector<float> offset(center - box.center);
+			float local[3], clamped[3];
+
+			for (int i = 0; i != 3; ++i)
+			{
+				local[i] = offset * box.axes[i];
+				clamped[i] = clamp(local[i], -box.extents[i], box.extents[i]);
+			}
+
+			if (clamped[0] != local[0] || clamped[1] != local[1] || clamped[2] != local[2])
+			{
+				ThreeVector<float> closestPoint(box.center + clamped[0] * box.axes[0] +
+					clamped[1] * box.axes[1] + clamped[2] * box.axes[2]);
+
+				return collideSphere(center, radius, closestPoint, box.axes[1]);
+			}
+
+			int axis = 0;
+			for (int i = 1; i != 3; ++i)
+			{
+				if (box.extents[i] - std::abs(local[i]) <
+					box.extents[axis] - std::abs(local[axis]))
+				{
+					axis = i;
+				}
+			}
+
+			ThreeVector<float> normal((local[axis] < .0f ? -1.f : 1.f) * box.axes[axis]);
+
+			return new Contact{{
+				center + (box.extents[axis] - std::abs(local[axis])) * normal,
+				ThreeVector<float>(normal)}};
+		}
+
+		// Separating axis test of two convex polyhedra given by their vertices.  The normal
+		// is the candidate axis of least penetration; the point of collision lies on the
+		// feature with fewer vertices of those facing each other along it.
+		template <unsigned vertexCount, unsigned otherVertexCount, unsigned axisCount>
+		Contact* separate(const ThreeVector<float> (& vertices)[vertexCount],
+			const ThreeVector<float> (& otherVertices)[otherVertexCount],
+			const ThreeVector<float> (& axes)[axisCount])
+		{
+			float leastDepth = std::numeric_limits<float>::infinity();
+			ThreeVector<float> normal; // from the first polyhedron to the other one
+
+			for (const auto& axis : axes)
+			{
+				// Cross products of parallel edges don't separate anything.
+				float lengthSquared = axis * axis;
+				if (lengthSquared < 1e-12f)
+					continue;
+
+				float range[2][2] = {
+					{std::numeric_limits<float>::infinity(),
+					 -std::numeric_limits<float>::infinity()},
+					{std::numeric_limits<float>::infinity(),
+					 -std::numeric_limits<float>::infinity()}};
+
+				for (const auto& vertex : vertices)
+				{
+					range[0][0] = std::min(range[0][0], vertex * axis);
+					range[0][1] = std::max(range[0][1], vertex * axis);
+				}
+
+				for (const auto& vertex : otherVertices)
+				{
+					range[1][0] = std::min(range[1][0], vertex * axis);
+					range[1][1] = std::max(range[1][1], vertex * axis);
+				}
+
+				if (range[0][1] < range[1][0] || range[1][1] < range[0][0])
+					return nullptr;
+
+				float length = std::sqrt(lengthSquared);
+
+				if (range[0][1] - range[1][0] < leastDepth * length)
+				{
+					leastDepth = (range[0][1] - range[1][0]) / length;
+					normal = axis / length;
+				}
+
+				if (range[1][1] - range[0][0] < leastDepth * length)
+				{
+					leastDepth = (range[1][1] - range[0][0]) / length;
+					normal = -axis / length;
+				}
+			}
+
+			// Vertices furthest along the normal and those of the other polyhedron furthest
+			// against it, give or take a tolerance.
+			const ThreeVector<float>* feature[2][std::max(vertexCount, otherVertexCount)];
+			unsigned featureSize[2] = {};
+
+			float extreme[2] = {
+				-std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity()};
+
+			for (const auto& vertex : vertices)
+				extreme[0] = std::max(extreme[0], vertex * normal);
+			for (const auto& vertex : otherVertices)
+				extreme[1] = std::min(extreme[1], vertex * normal);
+
+			const float tolerance = 1e-4f * (1.f + std::abs(extreme[0]));
+
+			for (const auto& vertex : vertices)
+			{
+				if (vertex * normal >= extreme[0] - tolerance)
+					feature[0][featureSize[0]++] = &vertex;
+			}
+
+			for (const auto& vertex : otherVertices)
+			{
+				if (vertex * normal <= extreme[1] + tolerance)
+					feature[1][featureSize[1]++] = &vertex;
+			}
+
+			if (featureSize[0] == 2u && featureSize[1] == 2u)
+			{
+				// two edges
+				float parameters[2];
+				getClosestParameters({feature[0][0], feature[1][0]},
+					{feature[0][1], feature[1][1]}, parameters);
+
+				return new Contact{{
+					(*feature[0][0] + parameters[0] * (*feature[0][1] - *feature[0][0]) +
+					 *feature[1][0] + parameters[1] * (*feature[1][1] - *feature[1][0])) / 2.f,
+					ThreeVector<float>(normal)}};
+			}
+
+			// Otherwise the center of the smaller feature, e.g. a vertex touching a face or a
+			// small face lying on a larger one.
+			ThreeVector<float> center[2] = {{.0f, .0f, .0f}, {.0f, .0f, .0f}};
+			float spread[2] = {.0f, .0f};
+
+			for (int i = 0; i != 2; ++i)
+			{
+				for (unsigned j = 0; j != featureSize[i]; ++j)
+					center[i] += *feature[i][j];
+				center[i] /= static_cast<float>(featureSize[i]);
+
+				for (unsigned j = 0; j != featureSize[i]; ++j)
+					spread[i] += (*feature[i][j] - center[i]) * (*feature[i][j] - center[i]);
+			}
+
+			return new Contact{{ThreeVector<float>(center[spread[1] <= spread[0]]),
+				ThreeVector<float>(normal)}};
+		}
+
+		Contact* collideSphereSphere(const Primitive& sphere, const Primitive& otherSphere) {
+			return collideSpheres(sphere.center, sphere.extents[0], otherSphere.center,
+				otherSphere.extents[0]);
+		}
+
+		Contact* collideSphereBox(const Primitive& sphere, const Primitive& box) {
+			return collideSphere(sphere.center, sphere.extents[0], box);
+		}
+
+		Contact* collideSphereCapsule(const Primitive& sphere, const Primitive& capsule)
+		{
+			ThreeVector<float> end[2] = {capsule.getEndPoint(-1.f), capsule.getEndPoint(1.f)};
+
+			float parameter[2];
+			getClosestParameters({&end[0], &sphere.center}, {&end[1], &sphere.center},
+				parameter);
+
+			return collideSpheres(sphere.center, sphere.extents[0],
+				end[0] + parameter[0] * (end[1] - end[0]), capsule.extents[0]);
+		}
+
+		Contact* collideBoxBox(const Primitive& box, const Primitive& otherBox)
+		{
+			ThreeVector<float> corners[2][8];
+			box.getCorners(corners[0]);
+			otherBox.getCorners(corners[1]);
+
+			ThreeVector<float> axes[15] = {
+				ThreeVector<float>(box.axes[0]), ThreeVector<float>(box.axes[1]),
+				ThreeVector<float>(box.axes[2]), ThreeVector<float>(otherBox.axes[0]),
+				ThreeVector<float>(otherBox.axes[1]), ThreeVector<float>(otherBox.axes[2])};
+
+			for (int i = 0; i != 3; ++i)
+			{
+				for (int j = 0; j != 3; ++j)
+					axes[6 + 3 * i + j] = getCrossProduct(box.axes[i], otherBox.axes[j]);
+			}
+
+			return separate(corners[0], corners[1], axes);
+		}
+
+		Contact* collideCapsuleBox(const Primitive& capsule, const Primitive& box)
+		{
+			ThreeVector<float> end[2] = {capsule.getEndPoint(-1.f), capsule.getEndPoint(1.f)};
+
+			float parameter = getClosestParameter(end[0], end[1],
+				[&box](const ThreeVector<float>& point) {
+					ThreeVector<float> offset(point - box.center);
+					return box.center +
+						clamp(offset * box.axes[0], -box.extents[0], box.extents[0]) * box.axes[0] +
+						clamp(offset * box.axes[1], -box.extents[1], box.extents[1]) * box.axes[1] +
+						clamp(offset * box.axes[2], -box.extents[2], box.extents[2]) * box.axes[2];
+				});
+
+			return collideSphere(end[0] + parameter * (end[1] - end[0]), capsule.extents[0],
+				box);
+		}
+
+		Contact* collideCapsuleCapsule(const Primitive& capsule,
+			const Primitive& otherCapsule)
+		{
+			ThreeVector<float> end[2][2] = {
+				{capsule.getEndPoint(-1.f), capsule.getEndPoint(1.f)},
+				{otherCapsule.getEndPoint(-1.f), otherCapsule.getEndPoint(1.f)}};
+
+			float parameter[2];
+			getClosestParameters({&end[0][0], &end[1][0]}, {&end[0][1], &end[1][1]},
+				parameter);
+
+			return collideSpheres(end[0][0] + parameter[0] * (end[0][1] - end[0][0]),
+				capsule.extents[0], end[1][0] + parameter[1] * (end[1][1] - end[1][0]),
+				otherCapsule.extents[0]);
+		}
+
+		Contact* collideSphereTriangle(const Primitive& sphere,
+			const ThreeVector<float>* const (& corners)[3])
+		{
+			return collideSphere(sphere.center, sphere.extents[0],
+				getClosestPoint(corners, sphere.center), getFallbackNormal(corners));
+		}
+
+		Contact* collideBoxTriangle(const Primitive& box,
+			const ThreeVector<float>* const (& corners)[3])
+		{
+			ThreeVector<float> boxCorners[8];
+			box.getCorners(boxCorners);
+
+			const ThreeVector<float> triangle[3] = {
+				ThreeVector<float>(*corners[0]), ThreeVector<float>(*corners[1]),
+				ThreeVector<float>(*corners[2])};
+
+			ThreeVector<float> edges[3] = {
+				triangle[1] - triangle[0], triangle[2] - triangle[1], triangle[0] - triangle[2]};
+
+			ThreeVector<float> axes[13] = {
+				ThreeVector<float>(box.axes[0]), ThreeVector<float>(box.axes[1]),
+				ThreeVector<float>(box.axes[2]), getCrossProduct(edges[0], edges[1])};
+
+			for (int i = 0; i != 3; ++i)
+			{
+				for (int j = 0; j != 3; ++j)
+					axes[4 + 3 * i + j] = getCrossProduct(box.axes[i], edges[j]);
+			}
+
+			return separate(boxCorners, triangle, axes);
+		}
+
+		Contact* collideCapsuleTriangle(const Primitive& capsule,
+			const ThreeVector<float>* const (& corners)[3])
+		{
+			ThreeVector<float> end[2] = {capsule.getEndPoint(-1.f), capsule.getEndPoint(1.f)};
+
+			float parameter = getClosestParameter(end[0], end[1],
+				[&corners](const ThreeVector<float>& point) {
+					return getClosestPoint(corners, point);
+				});
+
+			ThreeVector<float> center(end[0] + parameter * (end[1] - end[0]));
+
+			return collideSphere(center, capsule.extents[0],
+				getClosestPoint(corners, center), getFallbackNormal(corners));
+		}
+
+		typedef Contact* (*PrimitiveTest)(const Primitive&, const Primitive&);
+
+		template <PrimitiveTest test>
+		Contact* swapArguments(const Primitive& first, const Primitive& second) {
+			return test(second, first);
+		}
+
+		// Indexed by the types of both primitives less one, since MESH isn't a primitive.
+		const PrimitiveTest primitiveTests[3][3] = {
+			{collideSphereSphere, collideSphereBox, collideSphereCapsule},
+			{swapArguments<collideSphereBox>, collideBoxBox, swapArguments<collideCapsuleBox>},
+			{swapArguments<collideSphereCapsule>, collideCapsuleBox, collideCapsuleCapsule}};
+
+		typedef Contact* (*TriangleTest)(const Primitive&,
+			const ThreeVector<float>* const (&)[3]);
+
+		const TriangleTest triangleTests[3] = {
+			collideSphereTriangle, collideBoxTriangle, collideCapsuleTriangle};
+
+		unsigned getIndex(const Shape& shape)
+		{
+			assert(shape.type != ShapeType::MESH);
+			return static_cast<unsigned>(shape.type) - 1u;
+		}
+
+		// Ray against a sphere; see castRay(const Shape&, ...) and Ericson, section 5.3.2.
+		bool castRay(const ThreeVector<float>& center, float radius,
+			const ThreeVector<float>& origin, const ThreeVector<float>& direction,
+			float& distance, ThreeVector<float>& normal)
+		{
+			ThreeVector<float> offset(origin - center);
+			float projection = offset * direction;
+			float excess = offset * offset - radius * radius;
+
+			// outside and pointing away
+			if (excess > .0f && projection > .0f)
+				return false;
+
+			float discriminant = projection * projection - excess;
+			if (discriminant < .0f)
+				return false;
+
+			float hit = std::max(-projection - std::sqrt(discriminant), .0f);
+			if (hit >= distance)
+				return false;
+
+			distance = hit;
+			normal = hit == .0f ? -direction : (offset + hit * direction) / radius;
+			return true;
+		}
+	}
+
+	float getBoundingRadius(const Shape& shape)
+	{
+		switch (shape.type)
+		{
+			case ShapeType::BOX:
+				return std::sqrt(shape.extents[0] * shape.extents[0] +
+					shape.extents[1] * shape.extents[1] + shape.extents[2] * shape.extents[2]);
+
+			case ShapeType::CAPSULE:
+				return shape.extents[0] + shape.extents[1];
+
+			default:
+				return shape.extents[0];
+		}
+	}
+
+	bool getPenetration(const Shape& shape, const ModelViewMatrix<float>& matrix,
+		const ThreeVector<float>& point, float distance, ThreeVector<float>& normal,
+		float& depth)
+	{
+		Primitive primitive(shape, matrix);
+
+		// the point of the primitive's core (its center, axis or whole self) closest to point
+		ThreeVector<float> closestPoint(primitive.center);
+		float radius = primitive.extents[0];
+
+		if (shape.type == ShapeType::CAPSULE)
+		{
+			ThreeVector<float> end[2] = {
+				primitive.getEndPoint(-1.f), primitive.getEndPoint(1.f)};
+
+			float parameter[2];
+			getClosestParameters({&end[0], &point}, {&end[1], &point}, parameter);
+
+			closestPoint = end[0] + parameter[0] * (end[1] - end[0]);
+		}
+		else if (shape.type == ShapeType::BOX)
+		{
+			ThreeVector<float> offset(point - primitive.center);
+			float local[3], clamped[3];
+
+			for (int i = 0; i != 3; ++i)
+			{
+				local[i] = offset * primitive.axes[i];
+				clamped[i] = clamp(local[i], -primitive.extents[i], primitive.extents[i]);
+			}
+
+			if (clamped[0] == local[0] && clamped[1] == local[1] && clamped[2] == local[2])
+			{
+				// Inside; leave through the closest face.
+				int axis = 0;
+				for (int i = 1; i != 3; ++i)
+				{
+					if (primitive.extents[i] - std::abs(local[i]) <
+						primitive.extents[axis] - std::abs(local[axis]))
+					{
+						axis = i;
+					}
+				}
+
+				normal = (local[axis] < .0f ? -1.f : 1.f) * primitive.axes[axis];
+				depth = primitive.extents[axis] - std::abs(local[axis]) + distance;
+				return true;
+			}
+
+			closestPoint = primitive.center + clamped[0] * primitive.axes[0] +
+				clamped[1] * primitive.axes[1] + clamped[2] * primitive.axes[2];
+			radius = .0f;
+		}
+
+		ThreeVector<float> difference(point - closestPoint);
+		float length = difference.getNorm();
+
+		if (length >= radius + distance)
+			return false;
+
+		normal = length == .0f ? ThreeVector<float>{.0f, 1.f, .0f} : difference / length;
+		depth = radius + distance - length;
+		return true;
+	}
+
+	bool castRay(const Shape& shape, const ModelViewMatrix<float>& matrix,
+		const ThreeVector<float>& origin, const ThreeVector<float>& direction,
+		float& distance, ThreeVector<float>& normal)
+	{
+		Primitive primitive(shape, matrix);
+
+		if (shape.type == ShapeType::SPHERE)
+		{
+			return castRay(primitive.center, primitive.extents[0], origin, direction, distance,
+				normal);
+		}
+
+		ThreeVector<float> offset(origin - primitive.center);
+
+		if (shape.type == ShapeType::BOX)
+		{
+			// Clip the ray to the slab between each pair of faces.
+			float range[2] = {.0f, distance};
+			int entryAxis = -1;
+			float entrySign = .0f;
+
+			for (int i = 0; i != 3; ++i)
+			{
+				float start = offset * primitive.axes[i];
+				float speed = direction * primitive.axes[i];
+				float extent = primitive.extents[i];
+
+				if (speed == .0f)
+				{
+					if (std::abs(start) > extent)
+						return false;
+					continue;
+				}
+
+				float entry = (-extent - start) / speed, exit = (extent - start) / speed;
+				float sign = -1.f; // of the face entered through
+				if (entry > exit)
+				{
+					std::swap(entry, exit);
+					sign = 1.f;
+				}
+
+				if (entry > range[0])
+				{
+					range[0] = entry;
+					entryAxis = i;
+					entrySign = sign;
+				}
+				range[1] = std::min(range[1], exit);
+
+				if (range[0] > range[1])
+					return false;
+			}
+
+			if (range[0] >= distance)
+				return false;
+
+			distance = range[0];
+			normal = entryAxis == -1 ? -direction : entrySign * primitive.axes[entryAxis];
+			return true;
+		}
+
+		// A capsule is a cylinder between two spheres.
+		bool hit = castRay(primitive.getEndPoint(-1.f), primitive.extents[0], origin,
+			direction, distance, normal);
+		hit = castRay(primitive.getEndPoint(1.f), primitive.extents[0], origin, direction,
+			distance, normal) || hit;
+
+		const ThreeVector<float>& axis = primitive.axes[1];
+		ThreeVector<float> radialOffset(offset - (offset * axis) * axis);
+		ThreeVector<float> radialDirection(direction - (direction * axis) * axis);
+
+		float a = radialDirection * radialDirection;
+		float b = radialOffset * radialDirection;
+		float c = radialOffset * radialOffset - primitive.extents[0] * primitive.extents[0];
+
+		if (c <= .0f && std::abs(offset * axis) <= primitive.extents[1])
+		{
+			distance = .0f;
+			normal = -direction;
+			return true;
+		}
+
+		if (a == .0f || b * b - a * c < .0f)
+			return hit;
+
+		float side = (-b - std::sqrt(b * b - a * c)) / a;
+		float height = (offset + side * direction) * axis;
+
+		if (side < .0f || side >= distance || std::abs(height) > primitive.extents[1])
+			return hit;
+
+		distance = side;
+		normal = (radialOffset + side * radialDirection) / primitive.extents[0];
+		return true;
+	}
+
+	// See Moeller and Trumbore, Fast, Minimum Storage Ray/Triangle Intersection.
+	bool castRay(const ThreeVector<float>* const (& corners)[3],
+		const ThreeVector<float>& origin, const ThreeVector<float>& direction,
+		float& distance)
+	{
+		ThreeVector<float> edges[2] = {*corners[1] - *corners[0], *corners[2] - *corners[0]};
+		ThreeVector<float> normal(getCrossProduct(direction, edges[1]));
+
+		float determinant = edges[0] * normal;
+		if (determinant == .0f)
+			return false; // parallel
+
+		ThreeVector<float> offset(origin - *corners[0]);
+		float u = offset * normal / determinant;
+		if (u < .0f || u > 1.f)
+			return false;
+
+		ThreeVector<float> crossProduct(getCrossProduct(offset, edges[0]));
+		float v = direction * crossProduct / determinant;
+		if (v < .0f || u + v > 1.f)
+			return false;
+
+		float hit = edges[1] * crossProduct / determinant;
+		if (hit < .0f || hit >= distance)
+			return false;
+
+		distance = hit;
+		return true;
+	}
+
+	AxisAlignedBox getBounds(const Shape& shape, const ModelViewMatrix<float>& matrix)
+	{
+		Primitive primitive(shape, matrix);
+
+		// Half the size of the box.
+		float extents[3];
+
+		for (int i = 0; i != 3; ++i)
+		{
+			switch (shape.type)
+			{
+				case ShapeType::BOX:
+					extents[i] = std::abs(primitive.axes[0][i]) * primitive.extents[0] +
+						std::abs(primitive.axes[1][i]) * primitive.extents[1] +
+						std::abs(primitive.axes[2][i]) * primitive.extents[2];
+					break;
+
+				case ShapeType::CAPSULE:
+					extents[i] = std::abs(primitive.axes[1][i]) * primitive.extents[1] +
+						primitive.extents[0];
+					break;
+
+				default:
+					extents[i] = primitive.extents[0];
+			}
+		}
+
+		return {
+			{primitive.center[0] - extents[0], primitive.center[1] - extents[1],
+			 primitive.center[2] - extents[2]},
+			{primitive.center[0] + extents[0], primitive.center[1] + extents[1],
+			 primitive.center[2] + extents[2]}};
+	}
+
+	std::array<ThreeVector<float>, 2>* doesCollide(const Shape& shape,
+		const ModelViewMatrix<float>& matrix, const Shape& otherShape,
+		const ModelViewMatrix<float>& otherMatrix)
+	{
+		return primitiveTests[getIndex(shape)][getIndex(otherShape)](
+			Primitive(shape, matrix), Primitive(otherShape, otherMatrix));
+	}
+
+	std::array<ThreeVector<float>, 2>* doesCollide(const Shape& shape,
+		const ModelViewMatrix<float>& matrix, const ThreeVector<float>* const (& corners)[3])
+	{
+		return triangleTests[getIndex(shape)](Primitive(shape, matrix), corners);
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,102 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SHAPE_HPP_SEEN
+#define SHAPE_HPP_SEEN
+
+#include <array>
+
+#include "axisAlignedBox.hpp"
+#include "threeVector.hpp" // needs to precede modelViewMatrix.hpp
+#include "modelViewMatrix.hpp"
+
+namespace nut
+{
+	// What a rigid body collides as.  MESH stands for the triangles of its pools; the other
+	// types are primitives given in closed form by Shape::extents in object coordinates,
+	// centered at the origin.
+	enum class ShapeType : unsigned char
+	{
+		MESH,
+		SPHERE, // extents[0] is the radius.
+		BOX, // extents are half the lengths of the edges along the x, y and z axes.
+		CAPSULE // extents[0] is the radius and extents[1] half the length of the y axis.
+	};
+
+	struct Shape
+	{
+		ShapeType type;
+		float extents[3];
+	};
+
+	inline Shape makeSphere(float radius) {
+		return Shape{ShapeType::SPHERE, {radius, .0f, .0f}};
+	}
+
+	inline Shape makeBox(float halfWidth, float halfHeight, float halfDepth) {
+		return Shape{ShapeType::BOX, {halfWidth, halfHeight, halfDepth}};
+	}
+
+	inline Shape makeCapsule(float radius, float halfLength) {
+		return Shape{ShapeType::CAPSULE, {radius, halfLength, .0f}};
+	}
+
+	// Radius of the smallest sphere around the center of the primitive that contains it.
+	float getBoundingRadius(const Shape&);
+
+	// Whether the point is inside the primitive or closer to it than distance.  If so,
+	// normal is set to the direction out of the primitive there and depth to how far the
+	// point has to move along it to be distance away.
+	bool getPenetration(const Shape&, const ModelViewMatrix<float>&,
+		const ThreeVector<float>& point, float distance, ThreeVector<float>& normal,
+		float& depth);
+
+	// Point of the triangle with the given corners closest to point.
+	ThreeVector<float> getClosestPoint(const ThreeVector<float>* const (& corners)[3],
+		const ThreeVector<float>& point);
+
+	// Whether the ray from origin along direction, a unit vector, hits the primitive closer
+	// than distance.  If so, distance is set to where and normal to the surface normal
+	// there.  Rays from inside hit at once, against their direction.
+	bool castRay(const Shape&, const ModelViewMatrix<float>&,
+		const ThreeVector<float>& origin, const ThreeVector<float>& direction,
+		float& distance, ThreeVector<float>& normal);
+
+	// Same as above for the triangle with the given corners, from either side; the normal
+	// is left to the caller.
+	bool castRay(const ThreeVector<float>* const (& corners)[3],
+		const ThreeVector<float>& origin, const ThreeVector<float>& direction,
+		float& distance);
+
+	// Box in global coordinates around a primitive placed by the matrix.  The matrix
+	// mustn't scale.
+	AxisAlignedBox getBounds(const Shape&, const ModelViewMatrix<float>&);
+
+	// Test two primitives placed by the matrices.  Like Body::doesCollide, returns nullptr
+	// if they don't overlap and the point of collision and the normal otherwise.
+	// Dispatches to a closed-form test for each pair of types.
+	std::array<ThreeVector<float>, 2>* doesCollide(const Shape&,
+		const ModelViewMatrix<float>&, const Shape&, const ModelViewMatrix<float>&);
+
+	// Same as above for a primitive and a triangle given by its corners in global
+	// coordinates.
+	std::array<ThreeVector<float>, 2>* doesCollide(const Shape&,
+		const ModelViewMatrix<float>&, const ThreeVector<float>* const (& corners)[3]);
+}
+
+#endif //SHAPE_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,134 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef> // std::size_t
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sharedMemory.hpp"
+
+namespace nut
+{
+	namespace
+	{
+		bool isAlive(pid_t process)
+		{
+			return !(::kill(process, 0) == -1 && errno == ESRCH);
+		}
+	}
+
+	constexpr std::size_t SharedMemory::headerSize;
+
+	SharedMemory::SharedMemory(const std::string& name, std::size_t size, bool create) :
+		name{name}, isCreator{create}, mapping{nullptr},
+		mappingSize{size + SharedMemory::headerSize}
+	{
+		// Wait for the creator to open the block and give it its size.
+		while (!this->open(create))
+			std::this_thread::sleep_for(std::chrono::milliseconds{1});
+	}
+
+	SharedMemory::~SharedMemory()
+	{
+		::munmap(this->mapping, this->mappingSize);
+
+		if (this->isCreator)
+			::shm_unlink(this->name.c_str());
+	}
+
+	bool SharedMemory::open(bool create)
+	{
+		int fileDescriptor;
+
+		if (create)
+		{
+			::shm_unlink(this->name.c_str());
+			fileDescriptor = ::shm_open(this->name.c_str(),
+				O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR);
+
+			if (fileDescriptor != -1 &&
+				::ftruncate(fileDescriptor, static_cast<off_t>(this->mappingSize)) == -1)
+			{
+				::close(fileDescriptor);
+				::shm_unlink(this->name.c_str());
+				fileDescriptor = -1;
+			}
+		}
+		else
+		{
+			fileDescriptor = ::shm_open(this->name.c_str(), O_RDWR | O_CLOEXEC, 0);
+			if (fileDescriptor == -1 && errno == ENOENT)
+				return false;
+
+			struct stat status;
+			if (fileDescriptor != -1 && ::fstat(fileDescriptor, &status) == 0 &&
+				static_cast<std::size_t>(status.st_size) < this->mappingSize)
+			{
+				::close(fileDescriptor);
+				return false;
+			}
+		}
+
+		if (fileDescriptor == -1)
+			throw std::runtime_error{"can't open shared memory " + this->name};
+
+		this->mapping = ::mmap(nullptr, this->mappingSize, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fileDescriptor, 0);
+		::close(fileDescriptor); // The mapping keeps its own reference to the block.
+
+		if (this->mapping == MAP_FAILED)
+		{
+			if (create)
+				::shm_unlink(this->name.c_str());
+			throw std::runtime_error{"can't map shared memory " + this->name};
+		}
+
+		if (create)
+		{
+			new(this->mapping) std::atomic<pid_t>{::getpid()};
+			return true;
+		}
+
+		// The id is 0 until the creator has written it.
+		pid_t creator = static_cast<std::atomic<pid_t>*>(this->mapping)->load();
+
+		if (creator == 0 || !isAlive(creator))
+		{
+			::munmap(this->mapping, this->mappingSize);
+			return false;
+		}
+
+		return true;
+	}
+
+	bool SharedMemory::isCreatorAlive() const
+	{
+		return isAlive(static_cast<const std::atomic<pid_t>*>(this->mapping)->load());
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,71 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SHAREDMEMORY_HPP_SEEN
+#define SHAREDMEMORY_HPP_SEEN
+
+#include <cstddef> // std::size_t
+#include <string>
+
+namespace nut
+{
+	// A block of POSIX shared memory of fixed size, mapped for the lifetime of the object.
+	// One process creates it, zero-filled, and unlinks it again when done; others open it.
+	// Blocks left over by processes that died are replaced by their creators' successors;
+	// others wait for that rather than opening them.
+	class SharedMemory
+	{
+		public:
+
+		SharedMemory() = delete;
+		SharedMemory(const SharedMemory&) = delete;
+
+		// name starts with a slash, e.g. "/nut-world".  Opening waits until another process
+		// has created the block.  Throws std::runtime_error on failure.
+		SharedMemory(const std::string& name, std::size_t size, bool create);
+
+		~SharedMemory();
+
+		SharedMemory& operator=(const SharedMemory&) = delete;
+
+		void* getAddress() const {
+			return static_cast<char*>(this->mapping) + SharedMemory::headerSize;
+		}
+
+		std::size_t getSize() const { return this->mappingSize - SharedMemory::headerSize; }
+
+		// Whether the process that created the block still runs.
+		bool isCreatorAlive() const;
+
+		private:
+
+		// in front of the memory handed out, holding the process id of the creator
+		static constexpr std::size_t headerSize = 64u;
+
+		// Map the block, returning false if it doesn't exist yet or is left over.
+		bool open(bool create);
+
+		const std::string name;
+		const bool isCreator;
+
+		void* mapping;
+		std::size_t mappingSize;
+	};
+}
+
+#endif //SHAREDMEMORY_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
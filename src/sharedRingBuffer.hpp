@@ -0,0 +1,141 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SHAREDRINGBUFFER_HPP_SEEN
+#define SHAREDRINGBUFFER_HPP_SEEN
+
+#include <atomic>
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include "sharedMemory.hpp"
+
+namespace nut
+{
+	// Queue of fixed capacity in shared memory, between one process that pushes and one
+	// that pops.  Unlike RingBuffer, nothing is dropped: pushing to a full queue fails, and
+	// the caller decides how to wait.
+	template <typename T>
+	class SharedRingBuffer
+	{
+		static_assert(std::is_trivially_copyable<T>::value,
+			"values are copied between processes byte by byte");
+		static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+			"atomics in shared memory have to be lock-free");
+
+		public:
+
+		SharedRingBuffer() = delete;
+		SharedRingBuffer(const SharedRingBuffer&) = delete;
+
+		// Either process may create the queue; the other one waits for it.
+		SharedRingBuffer(const std::string& name, std::size_t capacity, bool create);
+
+		~SharedRingBuffer() = default;
+
+		SharedRingBuffer& operator=(const SharedRingBuffer&) = delete;
+
+		// Returns false if the queue is full.
+		bool push(const T& value);
+
+		// Returns false if the queue is empty.
+		bool pop(T& value);
+
+		// Whether the process that created the queue still runs, e.g. to stop waiting for
+		// it.
+		bool isCreatorAlive() const { return this->memory.isCreatorAlive(); }
+
+		private:
+
+		// Both counters only grow; their difference is the number of values queued.  They
+		// live on cache lines of their own, as each is written by a different process.
+		struct Header
+		{
+			alignas(64) std::atomic<unsigned long long> head; // values popped
+			alignas(64) std::atomic<unsigned long long> tail; // values pushed
+			std::atomic<unsigned> isReady;
+		};
+
+		static constexpr std::size_t slotOffset =
+			(sizeof(Header) + alignof(T) - 1u) / alignof(T) * alignof(T);
+
+		const std::size_t capacity;
+
+		SharedMemory memory;
+
+		Header* header;
+		T* slots;
+	};
+
+	template <typename T>
+	SharedRingBuffer<T>::SharedRingBuffer(const std::string& name, std::size_t capacity,
+		bool create) :
+		capacity{capacity},
+		memory{name, SharedRingBuffer::slotOffset + capacity * sizeof(T), create}
+	{
+		char* base = static_cast<char*>(this->memory.getAddress());
+		this->slots = reinterpret_cast<T*>(base + SharedRingBuffer::slotOffset);
+
+		if (create)
+		{
+			this->header = new(base) Header{};
+			this->header->head.store(0u, std::memory_order_relaxed);
+			this->header->tail.store(0u, std::memory_order_relaxed);
+			this->header->isReady.store(1u, std::memory_order_release);
+		}
+		else
+		{
+			this->header = reinterpret_cast<Header*>(base);
+
+			while (!this->header->isReady.load(std::memory_order_acquire))
+				std::this_thread::yield();
+		}
+	}
+
+	template <typename T>
+	bool SharedRingBuffer<T>::push(const T& value)
+	{
+		auto tail = this->header->tail.load(std::memory_order_relaxed);
+
+		if (tail - this->header->head.load(std::memory_order_acquire) == this->capacity)
+			return false;
+
+		this->slots[tail % this->capacity] = value;
+		this->header->tail.store(tail + 1u, std::memory_order_release);
+		return true;
+	}
+
+	template <typename T>
+	bool SharedRingBuffer<T>::pop(T& value)
+	{
+		auto head = this->header->head.load(std::memory_order_relaxed);
+
+		if (head == this->header->tail.load(std::memory_order_acquire))
+			return false;
+
+		value = this->slots[head % this->capacity];
+		this->header->head.store(head + 1u, std::memory_order_release);
+		return true;
+	}
+}
+
+#endif //SHAREDRINGBUFFER_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
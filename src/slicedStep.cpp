@@ -0,0 +1,43 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdexcept>
+
+#include "slicedStep.hpp"
+
+namespace nut
+{
+	SlicedStep::SlicedStep(float timeInterval) :
+		progress{timeInterval}, bodyChangeCount{RigidBody::bodyChangeCount} {}
+
+	bool SlicedStep::resume(std::chrono::steady_clock::time_point deadline)
+	{
+		if (RigidBody::bodyChangeCount != this->bodyChangeCount)
+		{
+			throw std::runtime_error{
+				"SlicedStep: rigid bodies were created or destroyed during the step"};
+		}
+
+		return RigidBody::advance(this->progress, deadline);
+	}
+
+	bool SlicedStep::isDone() const
+	{
+		return this->progress.stage == RigidBody::Progress::Stage::DONE;
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
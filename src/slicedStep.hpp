@@ -0,0 +1,72 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SLICEDSTEP_HPP_SEEN
+#define SLICEDSTEP_HPP_SEEN
+
+#include <chrono>
+
+#include "rigidBody.hpp"
+
+namespace nut
+{
+	// A step of RigidBody::advanceState taken in slices of bounded time, e.g. by a server
+	// that mustn't miss its tick because of a burst of collisions.  Each call of resume
+	// picks up exactly where the last one stopped: between rows of the all-pairs test or
+	// after a collision, between bodies tested against obstacles and between collision
+	// responses.  Taking all slices gives the same result as advanceState(float) with one
+	// step.
+	//
+	// The bodies are part of the way through the step until it's done, and must be left
+	// alone: from construction until the step is done, rigid bodies mustn't be created or
+	// destroyed, which resume checks, and no other step may be taken.  A step that's
+	// destroyed before it's done leaves them part of the way through it, and the next one
+	// starts from there; the contacts it found are dropped.
+	class SlicedStep
+	{
+		public:
+
+		SlicedStep(const SlicedStep&) = delete;
+
+		// Takes a step of timeInterval, split into substeps like those of advanceState.
+		explicit SlicedStep(float timeInterval = fixedTimeStep);
+
+		SlicedStep& operator=(const SlicedStep&) = delete;
+
+		// Advance the step until it's done or the deadline has passed, whichever comes first;
+		// returns whether it's done.  Slices overrun the deadline by a piece of work at most,
+		// e.g. one refined collision, and always do one, so every call makes progress.
+		bool resume(std::chrono::steady_clock::time_point deadline);
+
+		// Same with a budget starting now.
+		bool resume(std::chrono::steady_clock::duration budget) {
+			return this->resume(std::chrono::steady_clock::now() + budget);
+		}
+
+		bool isDone() const;
+
+		private:
+
+		RigidBody::Progress progress;
+
+		// RigidBody::bodyChangeCount when the step was constructed
+		const unsigned long bodyChangeCount;
+	};
+}
+
+#endif //SLICEDSTEP_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
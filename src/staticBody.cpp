@@ -0,0 +1,66 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "geometryArena.hpp"
+#include "staticBody.hpp"
+
+namespace nut
+{
+	std::vector<StaticBody*> StaticBody::staticBodies;
+
+	StaticBody::StaticBody(const ModelViewMatrix<float>& modelViewMatrix,
+		const Body::Pool& bodyPool, const RigidBody::Pool& rigidBodyPool) :
+			Body{nullptr, nullptr, bodyPool}, modelViewMatrix{modelViewMatrix},
+			tree{std::get<0>(bodyPool), std::get<1>(bodyPool),
+			     StaticBody::transform(*this, rigidBodyPool)}
+	{
+		StaticBody::staticBodies.push_back(this);
+	}
+
+	StaticBody::~StaticBody()
+	{
+		StaticBody::staticBodies.erase(std::find(StaticBody::staticBodies.begin(),
+			StaticBody::staticBodies.end(), this));
+
+		RigidBody::forgetContacts(this);
+
+		GeometryArena::release(*this);
+	}
+
+	const ThreeVector<float>* StaticBody::transform(StaticBody& body,
+		const RigidBody::Pool& pool)
+	{
+		GeometryArena::allocate(body, std::get<2>(pool), body.getTriangleCount());
+
+		for (unsigned i = 0; i != std::get<2>(pool); ++i)
+		{
+			body.vertices[i] = body.modelViewMatrix *
+				static_cast<ThreeVector<float, VERTEX>&>(std::get<0>(pool)[i]);
+		}
+
+		for (unsigned i = 0; i != body.getTriangleCount(); ++i)
+		{
+			body.surfaceNormals[i] = body.modelViewMatrix *
+				static_cast<ThreeVector<float, NORMAL>&>(std::get<1>(pool)[i]);
+		}
+
+		return body.vertices;
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
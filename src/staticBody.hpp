@@ -14,6 +14,64 @@
    Dynamics.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-// TODO?
+#ifndef STATICBODY_HPP_SEEN
+#define STATICBODY_HPP_SEEN
+
+#include <vector>
+
+#include "axisAlignedBox.hpp"
+#include "body.hpp"
+#include "contact.hpp"
+#include "modelViewMatrix.hpp"
+#include "rigidBody.hpp"
+#include "triangleTree.hpp"
+
+namespace nut
+{
+	// A body that never moves, e.g. level geometry.  Its vertices and surface normals are
+	// transformed to global coordinates once, on construction, and a TriangleTree is built
+	// over them.  Static bodies are neither moved nor tested against each other; a rigid
+	// body is only tested against the triangles the tree reports close to its own.
+	class StaticBody : Body
+	{
+		public:
+
+		StaticBody() = delete;
+		StaticBody(const StaticBody&) = delete;
+		StaticBody(const ModelViewMatrix<float>& modelViewMatrix, const Body::Pool&,
+			const RigidBody::Pool&);
+
+		~StaticBody();
+
+		StaticBody& operator=(const StaticBody&) = delete;
+
+		const ModelViewMatrix<float>& getObjectMatrix() const {
+			return this->modelViewMatrix;
+		}
+
+		const AxisAlignedBox& getBounds() const { return this->tree.getBounds(); }
+
+		CollisionFilter& getCollisionFilter() { return this->collisionFilter; }
+
+		private:
+
+		friend class RigidBody;
+		friend class SceneQuery;
+
+		// Allocate and fill the global geometry of a newly constructed body; returns its
+		// vertices.
+		static const ThreeVector<float>* transform(StaticBody&, const RigidBody::Pool&);
+
+		const ModelViewMatrix<float> modelViewMatrix;
+
+		const TriangleTree tree;
+
+		CollisionFilter collisionFilter;
+
+		static std::vector<StaticBody*> staticBodies;
+	};
+}
+
+#endif //STATICBODY_HPP_SEEN
 
 // vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,110 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <utility>
+
+#include "rigidBody.hpp"
+#include "stepper.hpp"
+
+namespace nut
+{
+	constexpr unsigned char Stepper::fresh;
+
+	Stepper::Stepper(std::chrono::steady_clock::duration period,
+		std::function<void()> beforeStep) :
+		period{period}, beforeStep{std::move(beforeStep)}
+	{
+		// Readers get the state before the first step until it's done.
+		this->publish();
+		this->thread = std::thread{&Stepper::run, this};
+	}
+
+	Stepper::~Stepper()
+	{
+		this->running.store(false, std::memory_order_relaxed);
+		this->thread.join();
+	}
+
+	const Snapshot& Stepper::getLatestSnapshot()
+	{
+		if (this->middle.load(std::memory_order_relaxed) & Stepper::fresh)
+		{
+			this->front = this->middle.exchange(this->front, std::memory_order_acq_rel) &
+				~Stepper::fresh;
+		}
+
+		return this->snapshots[this->front];
+	}
+
+	float Stepper::getInterpolationAlpha(const Snapshot& snapshot) const
+	{
+		auto age = std::chrono::steady_clock::now() - snapshot.time;
+
+		return std::min(std::chrono::duration<float>(age) /
+			std::chrono::duration<float>(this->period), 1.f);
+	}
+
+	void Stepper::run()
+	{
+		auto next = std::chrono::steady_clock::now() + this->period;
+
+		while (this->running.load(std::memory_order_relaxed))
+		{
+			std::this_thread::sleep_until(next);
+
+			if (this->beforeStep)
+				this->beforeStep();
+
+			RigidBody::advanceState(fixedTimeStep);
+			++this->stepCount;
+			this->publish();
+
+			next += this->period;
+
+			auto now = std::chrono::steady_clock::now();
+			if (now - next > maxSteps * this->period)
+				next = now;
+		}
+	}
+
+	void Stepper::publish()
+	{
+		Snapshot& snapshot = this->snapshots[this->back];
+
+		snapshot.bodies.assign(RigidBody::rigidBodies.begin(), RigidBody::rigidBodies.end());
+		snapshot.objectMatrices.clear();
+		snapshot.previousObjectMatrices.clear();
+
+		for (auto i : RigidBody::rigidBodies)
+		{
+			snapshot.objectMatrices.push_back(i->getObjectMatrix());
+			snapshot.previousObjectMatrices.push_back(i->previousModelViewMatrix);
+		}
+
+		snapshot.time = std::chrono::steady_clock::now();
+		snapshot.stepCount = this->stepCount;
+
+		this->back = this->middle.exchange(this->back | Stepper::fresh,
+			std::memory_order_acq_rel) & ~Stepper::fresh;
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,105 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STEPPER_HPP_SEEN
+#define STEPPER_HPP_SEEN
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "threeVector.hpp" // needs to precede modelViewMatrix.hpp
+#include "modelViewMatrix.hpp"
+
+namespace nut
+{
+	class RigidBody;
+
+	// The object matrices of all rigid bodies after a step, in the order the bodies were
+	// created.
+	struct Snapshot
+	{
+		std::vector<const RigidBody*> bodies;
+		std::vector<ModelViewMatrix<float>> objectMatrices;
+		std::vector<ModelViewMatrix<float>> previousObjectMatrices; // before the step
+		std::chrono::steady_clock::time_point time; // when the step was finished
+		unsigned long stepCount; // since the Stepper was constructed
+	};
+
+	// Advances the simulation on a thread of its own, one step of fixedTimeStep per period
+	// of real time, and publishes a Snapshot after each step.  Readers get the latest one
+	// without waiting for the step in progress: snapshots are passed through three buffers,
+	// one being written, one being read and one in between, swapped atomically.
+	//
+	// While a Stepper exists, bodies may be changed by beforeStep only, and mustn't be
+	// created or destroyed.
+	class Stepper
+	{
+		public:
+
+		Stepper() = delete;
+		Stepper(const Stepper&) = delete;
+
+		// beforeStep is called on the simulation thread before each step, e.g. to apply
+		// forces.  If the thread falls more than maxSteps periods behind, the time is
+		// dropped.
+		Stepper(std::chrono::steady_clock::duration period,
+			std::function<void()> beforeStep = std::function<void()>{});
+
+		// Waits for the step in progress.
+		~Stepper();
+
+		Stepper& operator=(const Stepper&) = delete;
+
+		// The snapshot published last.  Never blocks.  Only one thread may read snapshots;
+		// the reference is valid until its next call.
+		const Snapshot& getLatestSnapshot();
+
+		// How far the time since the snapshot was published is into the next period, between
+		// 0 and 1.  Renderers blend from previousObjectMatrices to objectMatrices by it.
+		float getInterpolationAlpha(const Snapshot&) const;
+
+		private:
+
+		void run();
+
+		// Fill the back buffer from the rigid bodies and swap it for the middle one.
+		void publish();
+
+		const std::chrono::steady_clock::duration period;
+		const std::function<void()> beforeStep;
+
+		Snapshot snapshots[3];
+
+		// Index of the buffer in between, or'ed with fresh if it hasn't been read yet.
+		std::atomic<unsigned char> middle{1u};
+		static constexpr unsigned char fresh = 4u;
+
+		unsigned char back = 0u; // owned by the simulation thread
+		unsigned char front = 2u; // owned by the reader
+
+		unsigned long stepCount = 0u;
+
+		std::atomic<bool> running{true};
+		std::thread thread;
+	};
+}
+
+#endif //STEPPER_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -94,6 +94,17 @@ namespace nut
 		return {rHS[0] - lHS[0], rHS[1] - lHS[1], rHS[2] - lHS[2]};
 	}
 
+	template <typename T, Interpretation interpretation>
+	inline ThreeVector<T, interpretation>&
+	ThreeVector<T, interpretation>::operator-=(const ThreeVector<T, interpretation> &rHS)
+	{
+		this->entries[0] -= rHS.entries[0];
+		this->entries[1] -= rHS.entries[1];
+		this->entries[2] -= rHS.entries[2];
+
+		return *this;
+	}
+
 	template <typename T, Interpretation interpretation>
 	inline ThreeVector<T, interpretation> ThreeVector<T, interpretation>::operator-() const
 	{
@@ -124,7 +135,10 @@ namespace nut
 	template <typename T, Interpretation interpretation>
 	inline ThreeVector<T, interpretation>& ThreeVector<T, interpretation>::operator/=(T rHS)
 	{
-		this[0] /= rHS; this[1] /= rHS; this[2] /= rHS;
+		this->entries[0] /= rHS;
+		this->entries[1] /= rHS;
+		this->entries[2] /= rHS;
+
 		return *this;
 	}
 
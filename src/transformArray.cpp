@@ -0,0 +1,138 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "transformArray.hpp"
+
+namespace nut
+{
+	constexpr std::size_t TransformArray::alignment;
+
+	ModelViewMatrix<float>* TransformArray::matrices = nullptr;
+	void* TransformArray::memory = nullptr;
+	std::size_t TransformArray::capacity = 0u;
+
+	std::vector<const RigidBody*> TransformArray::bodies;
+	std::vector<std::size_t> TransformArray::freeIndices;
+	std::vector<std::size_t> TransformArray::createdIndices;
+	std::vector<std::uint64_t> TransformArray::dirtyBits;
+
+	std::size_t TransformArray::allocate(const RigidBody& body,
+		const ModelViewMatrix<float>& modelViewMatrix)
+	{
+		// It may be that of another body, e.g. to create one in its place, and be freed
+		// below.
+		const ModelViewMatrix<float> matrix(modelViewMatrix);
+
+		std::size_t index;
+
+		if (!TransformArray::freeIndices.empty())
+		{
+			index = TransformArray::freeIndices.back();
+			TransformArray::freeIndices.pop_back();
+		}
+		else
+		{
+			index = TransformArray::bodies.size();
+
+			if (index == TransformArray::capacity)
+			{
+				std::size_t newCapacity = std::max(2u * TransformArray::capacity,
+					std::size_t{16u});
+
+				// malloc only guarantees the alignment of fundamental types.
+				void* newMemory = std::malloc(newCapacity * sizeof(ModelViewMatrix<float>) +
+					TransformArray::alignment - 1u);
+				if (!newMemory)
+					throw std::bad_alloc{};
+
+				auto newMatrices = reinterpret_cast<ModelViewMatrix<float>*>(
+					(reinterpret_cast<std::uintptr_t>(newMemory) + TransformArray::alignment - 1u) &
+					~(TransformArray::alignment - 1u));
+
+				// ModelViewMatrix<float> is trivially copyable.
+				if (index != 0u)
+					std::memcpy(newMatrices, TransformArray::matrices,
+						index * sizeof(ModelViewMatrix<float>));
+
+				std::free(TransformArray::memory);
+				TransformArray::memory = newMemory;
+				TransformArray::matrices = newMatrices;
+				TransformArray::capacity = newCapacity;
+			}
+
+			TransformArray::bodies.push_back(nullptr);
+			TransformArray::dirtyBits.resize((index + 64u) / 64u);
+		}
+
+		TransformArray::bodies[index] = &body;
+		TransformArray::matrices[index] = matrix;
+
+		TransformArray::markDirty(index);
+		TransformArray::createdIndices.push_back(index);
+
+		return index;
+	}
+
+	void TransformArray::release(std::size_t index)
+	{
+		TransformArray::bodies[index] = nullptr;
+		TransformArray::dirtyBits[index / 64u] &= ~(std::uint64_t{1u} << index % 64u);
+		TransformArray::freeIndices.push_back(index);
+
+		// Drop holes at the end, so the array doesn't keep the size of its busiest time.
+		while (!TransformArray::bodies.empty() && !TransformArray::bodies.back())
+			TransformArray::bodies.pop_back();
+
+		std::size_t size = TransformArray::bodies.size();
+
+		if (size == 0u)
+		{
+			std::free(TransformArray::memory);
+			TransformArray::memory = nullptr;
+			TransformArray::matrices = nullptr;
+			TransformArray::capacity = 0u;
+		}
+
+		TransformArray::freeIndices.erase(std::remove_if(
+			TransformArray::freeIndices.begin(), TransformArray::freeIndices.end(),
+			[size](std::size_t index) { return index >= size; }),
+			TransformArray::freeIndices.end());
+
+		TransformArray::dirtyBits.resize((size + 63u) / 64u);
+	}
+
+	void TransformArray::resetDirtyBits()
+	{
+		std::fill(TransformArray::dirtyBits.begin(), TransformArray::dirtyBits.end(),
+			std::uint64_t{0u});
+
+		for (auto index : TransformArray::createdIndices)
+		{
+			if (index < TransformArray::bodies.size())
+				TransformArray::markDirty(index);
+		}
+
+		TransformArray::createdIndices.clear();
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,95 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRANSFORMARRAY_HPP_SEEN
+#define TRANSFORMARRAY_HPP_SEEN
+
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <vector>
+
+#include "threeVector.hpp" // needs to precede modelViewMatrix.hpp
+#include "modelViewMatrix.hpp"
+
+namespace nut
+{
+	class RigidBody;
+
+	// Keeps the object matrices of all rigid bodies in a single block of memory, aligned to
+	// a cache line, so renderers and networking can read them in one go rather than body by
+	// body.  Each body keeps its index into the block for life; the indices of destroyed
+	// bodies are handed to new ones.  Unused indices leave holes with stale matrices.
+	//
+	// Creating a body may move the block, which invalidates the pointers returned below and
+	// any reference from RigidBody::getObjectMatrix.
+	class TransformArray
+	{
+		public:
+
+		TransformArray() = delete;
+
+		static constexpr std::size_t alignment = 64u;
+
+		// getSize() matrices, by index
+		static const ModelViewMatrix<float>* getMatrices() {
+			return TransformArray::matrices;
+		}
+
+		static std::size_t getSize() { return TransformArray::bodies.size(); }
+
+		// The body of each index, nullptr for holes.
+		static const RigidBody* const* getBodies() { return TransformArray::bodies.data(); }
+
+		// One bit per index, 64 to a word starting at the lowest bit, set for the matrices
+		// that changed in the last step and those of bodies created since the step before,
+		// so readers that only look after steps see new bodies too.  Moving bodies between
+		// steps doesn't set them.
+		static const std::uint64_t* getDirtyBits() {
+			return TransformArray::dirtyBits.data();
+		}
+
+		private:
+
+		friend class RigidBody;
+		friend class WorldState;
+
+		// Take an index for the body and set its matrix.
+		static std::size_t allocate(const RigidBody&, const ModelViewMatrix<float>&);
+
+		static void release(std::size_t index);
+
+		static void markDirty(std::size_t index) {
+			TransformArray::dirtyBits[index / 64u] |= std::uint64_t{1u} << index % 64u;
+		}
+
+		// Clear the dirty bits of all matrices but those of bodies created since the last
+		// call.
+		static void resetDirtyBits();
+
+		static ModelViewMatrix<float>* matrices; // within memory, aligned
+		static void* memory;
+		static std::size_t capacity;
+
+		static std::vector<const RigidBody*> bodies;
+		static std::vector<std::size_t> freeIndices;
+		static std::vector<std::size_t> createdIndices; // since resetDirtyBits
+		static std::vector<std::uint64_t> dirtyBits;
+	};
+}
+
+#endif //TRANSFORMARRAY_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
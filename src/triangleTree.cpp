@@ -0,0 +1,51 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "triangleTree.hpp"
+
+namespace nut
+{
+	AxisAlignedBox TriangleBounds::getBox(unsigned triangleIndex) const
+	{
+		const unsigned (& face)[3] = this->faces[triangleIndex];
+		AxisAlignedBox box = getEmptyBox();
+		grow(box, this->vertices[face[0]]);
+		grow(box, this->vertices[face[1]]);
+		grow(box, this->vertices[face[2]]);
+		return box;
+	}
+
+	float TriangleBounds::getCenter(unsigned triangleIndex, int axis) const
+	{
+		const unsigned (& face)[3] = this->faces[triangleIndex];
+		return this->vertices[face[0]][axis] + this->vertices[face[1]][axis] +
+			this->vertices[face[2]][axis];
+	}
+
+	TriangleTree::TriangleTree(const unsigned (* faces)[3], std::size_t triangleCount,
+		const ThreeVector<float> vertices[]) :
+		BoundsTree<TriangleBounds>{triangleCount, TriangleBounds{faces, vertices}}
+	{
+	}
+
+	void TriangleTree::refit(const unsigned (* faces)[3],
+		const ThreeVector<float> vertices[])
+	{
+		this->BoundsTree<TriangleBounds>::refit(TriangleBounds{faces, vertices});
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,56 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRIANGLETREE_HPP_SEEN
+#define TRIANGLETREE_HPP_SEEN
+
+#include <cstddef> // std::size_t
+
+#include "boundsTree.hpp"
+#include "threeVector.hpp"
+
+namespace nut
+{
+	// Bounds of the triangles of a mesh, for a BoundsTree over them.
+	struct TriangleBounds
+	{
+		const unsigned (* faces)[3];
+		const ThreeVector<float>* vertices;
+
+		AxisAlignedBox getBox(unsigned triangleIndex) const;
+		float getCenter(unsigned triangleIndex, int axis) const; // thrice the centroid
+	};
+
+	// Bounding volume hierarchy of axis-aligned boxes over the triangles of a mesh;
+	// visitors are given face indices.
+	class TriangleTree : public BoundsTree<TriangleBounds>
+	{
+		public:
+
+		TriangleTree() = delete;
+		TriangleTree(const unsigned (* faces)[3], std::size_t triangleCount,
+			const ThreeVector<float> vertices[]);
+
+		~TriangleTree() = default;
+
+		// Recompute all boxes for new vertex positions, keeping the topology of the tree.
+		void refit(const unsigned (* faces)[3], const ThreeVector<float> vertices[]);
+	};
+}
+
+#endif //TRIANGLETREE_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,141 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "rigidBody.hpp"
+#include "transformArray.hpp"
+#include "worldState.hpp"
+
+namespace nut
+{
+	namespace
+	{
+		bool isEqual(const float* first, const float* second, std::size_t count)
+		{
+			return std::equal(first, first + count, second);
+		}
+	}
+
+	constexpr std::size_t WorldState::chunkSize;
+
+	WorldState::WorldState()
+	{
+		this->capture();
+	}
+
+	bool WorldState::isSame(const RigidBody::State& state, const RigidBody& body)
+	{
+		return isEqual(state.modelViewMatrix, body.getObjectMatrix(), 16u) &&
+			isEqual(state.previousModelViewMatrix, body.getPreviousObjectMatrix(), 16u) &&
+			isEqual(state.velocity, body.getVelocity(), 3u) &&
+			isEqual(state.rotationAxis, body.getRotationAxis(), 3u) &&
+			state.angularFrequency == body.getAngularFrequency() &&
+			state.collisionLevel == body.getCollisionLevel();
+	}
+
+	void WorldState::capture()
+	{
+		std::size_t size = TransformArray::getSize();
+
+		bool isSameBodies = this->bodies && this->bodies->size() == size &&
+			std::equal(this->bodies->begin(), this->bodies->end(),
+				TransformArray::getBodies());
+
+		if (!isSameBodies)
+		{
+			auto bodies = std::make_shared<std::vector<RigidBody*>>(size, nullptr);
+			for (auto i : RigidBody::getBodies())
+				(*bodies)[i->getTransformIndex()] = i;
+
+			this->bodies = std::move(bodies);
+		}
+
+		std::vector<std::shared_ptr<const Chunk>> chunks(
+			(size + WorldState::chunkSize - 1u) / WorldState::chunkSize);
+
+		for (std::size_t i = 0u; i != chunks.size(); ++i)
+		{
+			std::size_t begin = i * WorldState::chunkSize;
+			std::size_t end = std::min(begin + WorldState::chunkSize, size);
+
+			if (isSameBodies)
+			{
+				const Chunk& chunk = *this->chunks[i];
+				bool isUnchanged = true;
+
+				for (std::size_t j = begin; j != end && isUnchanged; ++j)
+				{
+					if (auto body = (*this->bodies)[j])
+						isUnchanged = WorldState::isSame(chunk[j - begin], *body);
+				}
+
+				if (isUnchanged)
+				{
+					chunks[i] = this->chunks[i];
+					continue;
+				}
+			}
+
+			auto chunk = std::make_shared<Chunk>(end - begin);
+
+			for (std::size_t j = begin; j != end; ++j)
+			{
+				if (auto body = (*this->bodies)[j])
+					(*chunk)[j - begin] = body->getState();
+			}
+
+			chunks[i] = std::move(chunk);
+		}
+
+		this->chunks = std::move(chunks);
+
+		this->lastContacts =
+			std::make_shared<const std::vector<ContactEvent>>(RigidBody::getLastContacts());
+
+		this->carriedTime = getCarriedTime();
+	}
+
+	void WorldState::restore() const
+	{
+		if (this->bodies->size() != TransformArray::getSize() ||
+			!std::equal(this->bodies->begin(), this->bodies->end(),
+				TransformArray::getBodies()))
+		{
+			throw std::runtime_error{
+				"WorldState: bodies were created or destroyed since the capture"};
+		}
+
+		for (std::size_t i = 0u; i != this->bodies->size(); ++i)
+		{
+			auto body = (*this->bodies)[i];
+			const RigidBody::State& state =
+				(*this->chunks[i / WorldState::chunkSize])[i % WorldState::chunkSize];
+
+			if (!body || WorldState::isSame(state, *body))
+				continue;
+
+			body->setState(state);
+		}
+
+		RigidBody::setLastContacts(*this->lastContacts);
+
+		setCarriedTime(this->carriedTime);
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
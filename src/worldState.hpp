@@ -0,0 +1,74 @@
+/* Copyright 2012 Lukas Waymann
+
+   This file is part of Nutshell Dynamics.
+
+   Nutshell Dynamics is free software: you can redistribute it and/or modify it under the
+   terms of the GNU General Public License as published by the Free Software Foundation,
+   either version 3 of the License, or (at your option) any later version.
+
+   Nutshell Dynamics is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+   PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with Nutshell
+   Dynamics.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WORLDSTATE_HPP_SEEN
+#define WORLDSTATE_HPP_SEEN
+
+#include <cstddef> // std::size_t
+#include <memory>
+#include <vector>
+
+#include "contact.hpp"
+#include "rigidBody.hpp"
+
+namespace nut
+{
+	// A snapshot of all rigid bodies at one time, to go back to later, e.g. to try several
+	// impulses from the same start and keep the best.  Copies of a snapshot share the
+	// captured bodies in chunks of chunkSize, which never change once captured.  Capturing
+	// again shares the chunks in which no body changed since with the snapshot before, so
+	// snapshots that differ in a few places cost little more than one.
+	//
+	// Rigid bodies are global, so the world is in one state at a time: restore a snapshot,
+	// step, and capture the outcome before restoring another one.  Shapes, pools and
+	// geometry are left alone; restoring transforms the bodies that moved or changed their
+	// level of detail.  The time carried over by advanceState(float) is part of the
+	// snapshot; deformable bodies aren't.
+	class WorldState
+	{
+		public:
+
+		static constexpr std::size_t chunkSize = 64u;
+
+		// Capture the current state.
+		WorldState();
+
+		void capture();
+
+		// Put every body back to the captured state.  Throws std::runtime_error if bodies
+		// were created or destroyed since.
+		void restore() const;
+
+		private:
+
+		typedef std::vector<RigidBody::State> Chunk;
+
+		static bool isSame(const RigidBody::State&, const RigidBody&);
+
+		// by the bodies' indices into TransformArray, nullptr for holes
+		std::shared_ptr<const std::vector<RigidBody*>> bodies;
+
+		std::vector<std::shared_ptr<const Chunk>> chunks;
+
+		std::shared_ptr<const std::vector<ContactEvent>> lastContacts;
+
+		float carriedTime;
+	};
+}
+
+#endif //WORLDSTATE_HPP_SEEN
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,37 @@
+// Offline cooking tool: turns a Wavefront OBJ or binary STL file into a cooked mesh file
+// that nut::CookedMesh maps at startup.  Coincident vertices are welded and face normals
+// computed on the way; see nut::ImportedMesh.
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <tuple>
+
+#include "nutshell_dynamics/cookedMesh.hpp"
+#include "nutshell_dynamics/meshImport.hpp"
+
+int main(int argc, char* argv[])
+{
+	if (argc != 3)
+	{
+		std::cerr << "usage: " << argv[0] << " input.{obj,stl} output.nutmesh\n";
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		nut::ImportedMesh mesh{argv[1]};
+
+		nut::cookMesh(argv[2], mesh.getBodyPool(), mesh.getRigidBodyPool());
+
+		std::cout << argv[2] << ": " << std::get<2>(mesh.getRigidBodyPool()) <<
+			" vertices, " << std::get<1>(mesh.getBodyPool()) << " triangles\n";
+	}
+	catch (const std::exception& exception)
+	{
+		std::cerr << argv[0] << ": " << exception.what() << '\n';
+		return EXIT_FAILURE;
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,112 @@
+// Differential fuzzing tool for the narrow phase: runs Body::doesCollide and every faster
+// kernel on generated pairs of triangles and meshes, lists the cases they disagree on and
+// times each kernel on the same cases.  A single case is reproduced from the seed and its
+// index; see nut::NarrowPhaseHarness.  Rays are also cast into a scene without geometry,
+// whose trees have no leaves.
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "nutshell_dynamics/rigidBody.hpp"
+#include "nutshell_dynamics/narrowPhaseHarness.hpp"
+#include "nutshell_dynamics/sceneQuery.hpp"
+#include "nutshell_dynamics/staticBody.hpp"
+
+namespace
+{
+	// Mismatches listed in full; the rest are only counted.
+	constexpr std::size_t listedMismatches = 20u;
+
+	// Times each kernel tests all cases.
+	constexpr unsigned repetitions = 10u;
+
+	// Whether rays along the axes, through a scene without rigid bodies and with a static
+	// body without triangles, hit nothing.
+	bool castIntoEmptyScene()
+	{
+		const nut::Body::Pool bodyPool{nullptr, 0u};
+		const nut::RigidBody::Pool rigidBodyPool{nullptr, nullptr, 0u};
+		nut::StaticBody staticBody{nut::ModelViewMatrix<float>{}, bodyPool, rigidBodyPool};
+
+		nut::Ray rays[3];
+		for (unsigned i = 0u; i != 3u; ++i)
+		{
+			rays[i].origin = nut::ThreeVector<float>{.0f, .0f, .0f};
+			rays[i].direction = nut::ThreeVector<float>{.0f, .0f, .0f};
+			rays[i].direction[i] = 1.f;
+			rays[i].length = 1e3f;
+		}
+
+		nut::RayHit hits[3];
+		nut::SceneQuery{}.castRays(rays, 3u, hits);
+
+		for (const auto& hit : hits)
+		{
+			if (hit.rigidBody || hit.staticBody || hit.heightfield || hit.deformableBody)
+				return false;
+		}
+
+		return true;
+	}
+}
+
+unsigned short nut::refineIterations = 24u; // the harness never steps
+
+int main(int argc, char* argv[])
+{
+	if (argc != 3 && !(argc == 4 && std::string{argv[2]} == "-show"))
+	{
+		std::cerr << "usage: " << argv[0] << " seed caseCount\n"
+			"       " << argv[0] << " seed -show caseIndex\n";
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		nut::NarrowPhaseHarness harness{std::stoull(argv[1])};
+
+		if (argc == 4)
+		{
+			harness.describe(std::cout, std::stoull(argv[3]));
+			return EXIT_SUCCESS;
+		}
+
+		if (!castIntoEmptyScene())
+		{
+			std::cout << "rays hit an empty scene\n";
+			return EXIT_FAILURE;
+		}
+
+		std::uint64_t caseCount = std::stoull(argv[2]);
+		auto mismatches = harness.fuzz(0u, caseCount);
+
+		for (std::size_t i = 0; i != mismatches.size() && i != listedMismatches; ++i)
+		{
+			std::cout << "case " << mismatches[i].caseIndex << " (" <<
+				nut::getName(mismatches[i].type) << "): " << mismatches[i].kernel << ' ' <<
+				mismatches[i].problem << '\n';
+		}
+
+		std::cout << mismatches.size() << " mismatches in " << caseCount << " cases\n";
+
+		for (const auto& time : harness.time(0u, caseCount, repetitions))
+		{
+			std::cout << std::setw(16) << std::left << time.first << std::fixed <<
+				std::setprecision(1) << time.second * 1e9 / (caseCount * repetitions) <<
+				" ns per case\n";
+		}
+
+		return mismatches.empty() ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	catch (const std::exception& exception)
+	{
+		std::cerr << argv[0] << ": " << exception.what() << '\n';
+		return EXIT_FAILURE;
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
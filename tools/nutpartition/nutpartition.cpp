@@ -0,0 +1,230 @@
+// Driver for nut::Partition: forks a process per region, steps spheres that cross the
+// borders between the regions in lockstep, and checks that each body ends up owned by
+// exactly one region unless it left them all.  With -kill, the process of one region
+// quits halfway through, and all others have to stop with an error rather than wait for
+// it forever.
+
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "nutshell_dynamics/rigidBody.hpp"
+#include "nutshell_dynamics/partition.hpp"
+
+namespace
+{
+	// Regions are this wide and lined up along x; bodies leave them all at either end.
+	constexpr float regionWidth = 20.f;
+
+	// more than a sphere and the distance it moves per step
+	constexpr float margin = 2.f;
+
+	constexpr float timeStep = .1f;
+
+	// Seconds a region may take, after which it counts as hung.
+	constexpr unsigned timeout = 60u;
+
+	// What the process of a region tells the driver.
+	struct Report
+	{
+		unsigned region;
+		bool hasFailed;
+		std::size_t bodyCount;
+		std::size_t ghostCount;
+		std::size_t strayCount; // bodies that left all regions and were destroyed
+	};
+
+	Report runRegion(const std::string& name, unsigned regionCount, unsigned region,
+		unsigned bodyCount, unsigned stepCount, bool isKilled)
+	{
+		std::vector<nut::AxisAlignedBox> regions;
+
+		for (unsigned i = 0u; i != regionCount; ++i)
+		{
+			regions.push_back(nut::AxisAlignedBox{{i * regionWidth, -1e3f, -1e3f},
+				{(i + 1u) * regionWidth, 1e3f, 1e3f}});
+		}
+
+		nut::Partition partition{name, regions, region, margin};
+
+		// Every process draws all bodies, the same way, and creates those in its region.
+		std::mt19937 random{1u};
+		std::uniform_real_distribution<float> position{.0f, regionCount * regionWidth};
+		std::uniform_real_distribution<float> height{-10.f, 10.f};
+		std::uniform_real_distribution<float> speed{-3.f, 3.f};
+		const float momentOfInertia[3] = {.1f, .1f, .1f};
+
+		for (unsigned i = 0u; i != bodyCount; ++i)
+		{
+			nut::ModelViewMatrix<float> modelViewMatrix;
+			modelViewMatrix[12] = position(random);
+			modelViewMatrix[13] = height(random);
+			const nut::ThreeVector<float> velocity{speed(random), .0f, .0f};
+
+			if (regions[region].min[0] <= modelViewMatrix[12] &&
+				modelViewMatrix[12] < regions[region].max[0])
+			{
+				partition.createBody(1.f, momentOfInertia, modelViewMatrix, velocity, .0f,
+					nut::ThreeVector<float>{.0f, 1.f, .0f}, nut::makeSphere(.5f));
+			}
+		}
+
+		Report report{region, false, 0u, 0u, 0u};
+
+		for (unsigned i = 0u; i != stepCount; ++i)
+		{
+			if (isKilled && i == stepCount / 2u)
+				std::_Exit(EXIT_FAILURE);
+
+			partition.advanceState(timeStep);
+
+			const std::vector<std::uint64_t> strays = partition.getStrays();
+			for (auto id : strays)
+				partition.destroyBody(id);
+
+			report.strayCount += strays.size();
+		}
+
+		report.bodyCount = partition.getBodies().size();
+		report.ghostCount = partition.getGhosts().size();
+
+		return report;
+	}
+}
+
+unsigned short nut::refineIterations = 24u;
+
+int main(int argc, char* argv[])
+{
+	if (argc != 4 && !(argc == 6 && std::string{argv[4]} == "-kill"))
+	{
+		std::cerr << "usage: " << argv[0] << " regionCount bodyCount stepCount" <<
+			" [-kill region]\n";
+		return EXIT_FAILURE;
+	}
+
+	unsigned regionCount, bodyCount, stepCount;
+	int killedRegion = -1;
+
+	try
+	{
+		regionCount = std::stoul(argv[1]);
+		bodyCount = std::stoul(argv[2]);
+		stepCount = std::stoul(argv[3]);
+
+		if (argc == 6)
+			killedRegion = std::stoi(argv[5]);
+	}
+	catch (const std::exception& exception)
+	{
+		std::cerr << argv[0] << ": " << exception.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	const std::string name = "nutpartition-" + std::to_string(::getpid());
+
+	int reports[2];
+	if (::pipe(reports) == -1)
+	{
+		std::cerr << argv[0] << ": can't create a pipe\n";
+		return EXIT_FAILURE;
+	}
+
+	for (unsigned i = 0u; i != regionCount; ++i)
+	{
+		pid_t process = ::fork();
+
+		if (process == -1)
+		{
+			std::cerr << argv[0] << ": can't fork\n";
+			return EXIT_FAILURE;
+		}
+
+		if (process != 0)
+			continue;
+
+		::close(reports[0]);
+		::alarm(timeout);
+
+		Report report{i, true, 0u, 0u, 0u};
+
+		try
+		{
+			report = runRegion(name, regionCount, i, bodyCount, stepCount,
+				static_cast<int>(i) == killedRegion);
+		}
+		catch (const std::exception& exception)
+		{
+			std::cerr << "region " << i << ": " << exception.what() << '\n';
+		}
+
+		bool isWritten = ::write(reports[1], &report, sizeof report) == sizeof report;
+		std::_Exit(isWritten && !report.hasFailed ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	::close(reports[1]);
+
+	// Reap the processes as they quit: one that died lingers as a zombie until then, which
+	// its neighbours can't tell from a live process.
+	unsigned hungCount = 0u;
+	int status;
+
+	while (::wait(&status) != -1)
+	{
+		if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM)
+			++hungCount;
+	}
+
+	std::size_t ownedCount = 0u, ghostCount = 0u, strayCount = 0u;
+	unsigned finishedCount = 0u, failedCount = 0u;
+	Report report;
+
+	while (::read(reports[0], &report, sizeof report) == sizeof report)
+	{
+		if (report.hasFailed)
+		{
+			++failedCount;
+			continue;
+		}
+
+		std::cout << "region " << report.region << ": " << report.bodyCount <<
+			" bodies, " << report.ghostCount << " ghosts, " << report.strayCount <<
+			" strays\n";
+
+		++finishedCount;
+		ownedCount += report.bodyCount;
+		ghostCount += report.ghostCount;
+		strayCount += report.strayCount;
+	}
+
+	if (hungCount != 0u)
+	{
+		std::cout << hungCount << " regions hung\n";
+		return EXIT_FAILURE;
+	}
+
+	if (killedRegion != -1)
+	{
+		bool isStopped = finishedCount == 0u && failedCount + 1u == regionCount;
+		std::cout << "region " << killedRegion << " quit; " << failedCount <<
+			" of the others stopped with an error\n";
+		return isStopped ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	bool isKept = finishedCount == regionCount && ownedCount + strayCount == bodyCount;
+	std::cout << ownedCount << " bodies owned and " << strayCount << " strays of " <<
+		bodyCount << ", " << ghostCount << " ghosts\n";
+
+	return isKept ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet
@@ -0,0 +1,48 @@
+// Offline simplification tool: turns a Wavefront OBJ or binary STL file into a cooked
+// mesh file of a collision proxy for it, either its convex hull or a clustered mesh with
+// cells of the given size.  The deviation of the proxy is stored along with it and
+// printed; see nut::CollisionProxy.
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <tuple>
+
+#include "nutshell_dynamics/collisionProxy.hpp"
+#include "nutshell_dynamics/cookedMesh.hpp"
+#include "nutshell_dynamics/meshImport.hpp"
+
+int main(int argc, char* argv[])
+{
+	if (argc != 4)
+	{
+		std::cerr << "usage: " << argv[0] <<
+			" input.{obj,stl} output.nutmesh {hull|cellSize}\n";
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		nut::ImportedMesh mesh{argv[1]};
+
+		bool isHull = std::string{argv[3]} == "hull";
+		nut::CollisionProxy proxy{mesh.getBodyPool(), mesh.getRigidBodyPool(),
+			isHull ? nut::ProxyType::CONVEX_HULL : nut::ProxyType::CLUSTERED,
+			isHull ? .0f : std::stof(argv[3])};
+
+		nut::cookMesh(argv[2], proxy.getBodyPool(), proxy.getRigidBodyPool(), nullptr, 0u,
+			proxy.getDeviation());
+
+		std::cout << argv[2] << ": " << std::get<2>(proxy.getRigidBodyPool()) <<
+			" vertices, " << std::get<1>(proxy.getBodyPool()) << " triangles, deviation " <<
+			proxy.getDeviation() << '\n';
+	}
+	catch (const std::exception& exception)
+	{
+		std::cerr << argv[0] << ": " << exception.what() << '\n';
+		return EXIT_FAILURE;
+	}
+}
+
+// vim: tw=90 ts=2 sts=-1 sw=0 noet